@@ -10,7 +10,7 @@ extern const int fileoutputflag;
 extern const int printflag;
 extern const int cpmflag;
 
-extern uint16_t RAMoffset;
+extern uint32_t writeMap[256];
 
 void Emulate8080Op(State8080* state, FILE *output){
     unsigned char *opcode = &state->memory[state->pc];
@@ -2690,9 +2690,10 @@ void Emulate8080Op(State8080* state, FILE *output){
             }
             break;
         case 0xfb:  //EI
-            //Enable interrupts
+            //Enable interrupts, from after the next instruction on. That lets a handler end with EI, RET without another interrupt coming in between and nesting on the stack.
             state->int_enable = 1;
             state->cyclecount += 4;
+            state->ei_cycle = state->cyclecount;
             break;
         case 0xfc:  //CM     D16
             //Condition call (negative integer ("minus"))
@@ -2780,19 +2781,13 @@ void MemWrite(State8080* state, uint16_t location, uint8_t value){
     By doing this, you will essentially get the modulus 8192 of that location, and then write to that location in RAM.
     So if the program attempts to write at location 0x5132, AND that with 0x1FFF which equals 0x1132, then add that to 0x2000 which equals RAM location 0x3132.
 
-    Note: If using this processor emulator for non-space invaders emulation, this function may need to be changed.
+    Other games on the same board map their memory differently, so rather than checking addresses here, each 256 byte page of the address space has an entry in writeMap saying where writes to it go, built from the machine description by SelectMachine.
+    For Space Invaders, pages 0x00 - 0x1F (ROM) go to a spare page past the end of memory that nothing reads, pages 0x20 - 0x3F go to themselves, and pages from 0x40 up go to (page & 0x1F) + 0x20, the same as the masking above.
+    So a write is one table lookup, with no branches, whatever the game.
+    Reads don't go through a table, they read memory at the address as is. So a read through a mirror gets zeros rather than the RAM, which none of the games rely on. Mapping reads too would mean a lookup on every opcode fetch and operand read, not just on writes.
     */
 
-    if (location < RAMoffset && cpmflag == 0){
-        //printf("Error: program attempts to write into ROM! Memory write was attempted at: %04X using the value %02X\n", location, value);
-    }
-    else if (location >= 0x4000 && cpmflag == 0){
-        //printf("Program attempts to write outside of RAM space @ %04X, mirroring to RAM location %04X...\n", location, (location & 0x1FFF) + 0x2000);
-        state->memory[(location & 0x1FFF) + 0x2000] = value;
-    }
-    else{
-        state->memory[location] = value;
-    }
+    state->memory[writeMap[location >> 8] + (location & 0xFF)] = value;
 }
 
 void Jump(State8080* state, unsigned char *opcode){
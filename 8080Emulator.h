@@ -27,7 +27,9 @@ typedef struct State8080 {
     uint8_t     *memory;
     struct      ConditionCodes      cc;
     uint8_t     int_enable;
-    int         cyclecount;
+    uint64_t    ei_cycle;       //Cycle count just after the last EI. Like on the real 8080, interrupts are only taken once the instruction after EI has run too.
+    uint64_t    cyclecount;     //Cycles run since power on.
+    void        *io;    //Hardware outside the CPU (shift register, sound ports etc.). Only used by the I/O port handlers.
 } State8080;
 
 //Function declarations.
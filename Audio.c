@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "Audio.h"
+#include "Timing.h"
+
+/*
+Audio output: one mono 16 bit stream, fed through a ring buffer.
+How much sound is kept queued (the target) is all latency, but too little and the device runs dry whenever a callback or an update comes late. How late they come depends on the host, so the target adapts: it starts as low as the device's buffer allows, grows straight away when the device runs dry, and creeps back down while it doesn't, but never below what the callbacks' measured jitter needs. SDL can't resize the device's own buffer without closing and reopening it, which would glitch, so the device is opened with a small buffer and the target is what moves.
+*/
+
+#define GROW_STEP 0.004         //Seconds added to the target on each underrun.
+#define SHRINK_AFTER 2          //Seconds without underruns before the target is lowered a step.
+
+int audioRate = 48000;      //Sample rate the device actually runs at.
+
+static AudioRing ring;
+static SDL_AudioDeviceID device = 0;
+static int deviceSamples = AUDIO_DEVICE_SAMPLES;
+static double minLatency = 0.0;     //Bounds on the target, in seconds. 0 leaves it to the device buffer and the jitter.
+static double maxLatency = 0.1;
+static int target = 0;              //Samples.
+static int lastUnderruns = 0;
+static int calmSamples = 0;         //Samples written since the last underrun or shrink.
+static int jitterSamples = 0;       //Worst jitter measured over the last calm period.
+
+//Runs on SDL's audio thread. Takes whatever has been written, and plays silence for the rest if the emulation hasn't kept up.
+static void AudioCallback(void *userdata, Uint8 *stream, int length){
+    static Uint64 last = 0;
+    Uint64 now = TimerNow();
+    int16_t *out = (int16_t *) stream;
+    int wanted = length / (int) sizeof(int16_t);
+    unsigned int read = (unsigned int) SDL_AtomicGet(&ring.readCount);
+    unsigned int available = (unsigned int) SDL_AtomicGet(&ring.writeCount) - read;
+    int keep = SDL_AtomicSet(&ring.flushTo, -1);
+    int count;
+    int i = 0;
+
+    //Skip what the writer asked to have dropped. Only this thread moves the read count, so it's the one that has to do it.
+    if (keep >= 0 && available > (unsigned int) keep){
+        read += available - keep;
+        available = keep;
+    }
+    count = (int) available < wanted ? (int) available : wanted;
+
+    //Callbacks should come exactly one buffer apart. Keep the worst difference for the writer.
+    if (last != 0){
+        double interval = TimerSeconds(now - last);
+        double expected = (double) wanted / audioRate;
+        int jitter = (int) (1000000.0 * (interval > expected ? interval - expected : expected - interval));
+        if (jitter > SDL_AtomicGet(&ring.jitter)){
+            SDL_AtomicSet(&ring.jitter, jitter);
+        }
+    }
+    last = now;
+
+    //The samples have to be read after the write count that says they're there.
+    SDL_MemoryBarrierAcquire();
+    while (i < count){
+        out[i] = ring.samples[(read + i) & (AUDIO_RING_SIZE - 1)];
+        i++;
+    }
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring.readCount, (int) (read + count));
+
+    //Running dry before anything was written is just startup, not an underrun, and so is running dry while suspended.
+    if (count < wanted){
+        memset(&out[count], 0, (wanted - count) * sizeof(int16_t));
+        if ((read != 0 || count > 0) && SDL_AtomicGet(&ring.suspended) == 0){
+            SDL_AtomicAdd(&ring.underruns, 1);
+        }
+    }
+}
+
+//Bounds on the target latency, in milliseconds. Call before OpenAudio.
+void SetAudioLatency(int minimum, int maximum){
+    minLatency = minimum / 1000.0;
+    maxLatency = maximum / 1000.0;
+}
+
+//Keep the target between the bounds, and above the one buffer plus one update it can never go below.
+static void ClampTarget(void){
+    int floor = deviceSamples + audioRate / 120;
+    int minimum = (int) (minLatency * audioRate);
+    int maximum = (int) (maxLatency * audioRate);
+
+    if (target > maximum){
+        target = maximum;
+    }
+    if (target > AUDIO_RING_SIZE / 2){
+        target = AUDIO_RING_SIZE / 2;
+    }
+    if (target < minimum){
+        target = minimum;
+    }
+    if (target < floor){
+        target = floor;
+    }
+}
+
+//Called with every write. Grow the target on an underrun, and every SHRINK_AFTER seconds without one, bring it a quarter of the way down to what the jitter measured in that time needs.
+static void AdaptTarget(int written){
+    int underruns = SDL_AtomicGet(&ring.underruns);
+    int64_t jitter = (int64_t) SDL_AtomicGet(&ring.jitter) * audioRate / 1000000;
+    int needed;
+
+    //A stall (the window being dragged, say) can make one callback very late. More than the ring holds couldn't be queued anyway.
+    if (jitter > AUDIO_RING_SIZE){
+        jitter = AUDIO_RING_SIZE;
+    }
+    if (jitter > jitterSamples){
+        jitterSamples = (int) jitter;
+    }
+
+    if (underruns != lastUnderruns){
+        lastUnderruns = underruns;
+        target += (int) (GROW_STEP * audioRate);
+        calmSamples = 0;
+        ClampTarget();
+        return;
+    }
+
+    calmSamples += written;
+    if (calmSamples < SHRINK_AFTER * audioRate){
+        return;
+    }
+    needed = deviceSamples + audioRate / 120 + jitterSamples;
+    if (target > needed){
+        target -= (target - needed + 3) / 4;
+    }
+    ClampTarget();
+    calmSamples = 0;
+    jitterSamples = 0;
+
+    //There's a small chance of losing a value the callback stores right in between, which only means one slightly low measurement.
+    SDL_AtomicSet(&ring.jitter, 0);
+}
+
+//Open the default audio device and start it playing. Returns 0 on success. The device may pick a different rate, which ends up in audioRate.
+int OpenAudio(int rate){
+    SDL_AudioSpec want;
+    SDL_AudioSpec have;
+
+    SDL_zero(want);
+    want.freq = rate;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = AUDIO_DEVICE_SAMPLES;
+    want.callback = AudioCallback;
+
+    SDL_AtomicSet(&ring.readCount, 0);
+    SDL_AtomicSet(&ring.writeCount, 0);
+    SDL_AtomicSet(&ring.underruns, 0);
+    SDL_AtomicSet(&ring.jitter, 0);
+    SDL_AtomicSet(&ring.suspended, 0);
+    SDL_AtomicSet(&ring.flushTo, -1);
+    ring.overruns = 0;
+    lastUnderruns = 0;
+    calmSamples = 0;
+    jitterSamples = 0;
+
+    device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (device == 0){
+        printf("Error: could not open audio device: %s\n", SDL_GetError());
+        return 1;
+    }
+    audioRate = have.freq;
+    deviceSamples = have.samples;
+    target = 0;
+    ClampTarget();
+    SDL_PauseAudioDevice(device, 0);
+    return 0;
+}
+
+void CloseAudio(void){
+    if (device != 0){
+        SDL_CloseAudioDevice(device);
+        device = 0;
+    }
+}
+
+//Queue samples for playing. Returns how many fit, the rest are dropped.
+int WriteAudio(const int16_t *samples, int count){
+    unsigned int write = (unsigned int) SDL_AtomicGet(&ring.writeCount);
+    unsigned int space = AUDIO_RING_SIZE - (write - (unsigned int) SDL_AtomicGet(&ring.readCount));
+    int i = 0;
+
+    if (SDL_AtomicGet(&ring.suspended)){
+        return count;
+    }
+    if (count > (int) space){
+        count = (int) space;
+        ring.overruns++;
+    }
+    while (i < count){
+        ring.samples[(write + i) & (AUDIO_RING_SIZE - 1)] = samples[i];
+        i++;
+    }
+
+    //Make the samples visible before the count that tells the callback about them.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring.writeCount, (int) (write + count));
+    AdaptTarget(count);
+    return count;
+}
+
+/*
+Stop or start queuing what's written, for when emulation runs faster than real time. The device can only play sound at the speed it was made at, so anything more just piles up in the ring: it fills, and what's queued has to drain at half a percent faster than real time once emulation is back to normal speed, which takes half a minute.
+Suspending drops what's queued, so it goes quiet straight away, and drops everything written after. Resuming brings the queue to the target at once: silence is added if it's short, and the callback drops what's over.
+*/
+void SuspendAudio(int suspend){
+    static const int16_t silence[AUDIO_RING_SIZE];
+    int queued;
+
+    if (device == 0){
+        return;
+    }
+    if (suspend){
+        SDL_AtomicSet(&ring.suspended, 1);
+        SDL_AtomicSet(&ring.flushTo, 0);
+        return;
+    }
+    if (SDL_AtomicGet(&ring.suspended) == 0){
+        return;
+    }
+    SDL_AtomicSet(&ring.suspended, 0);
+    queued = AudioQueued();
+    if (queued < target){
+        WriteAudio(silence, target - queued);
+    }
+    else{
+        SDL_AtomicSet(&ring.flushTo, target);
+    }
+}
+
+//Samples written but not played yet.
+int AudioQueued(void){
+    return (int) ((unsigned int) SDL_AtomicGet(&ring.writeCount) - (unsigned int) SDL_AtomicGet(&ring.readCount));
+}
+
+//How many samples to keep queued. See the top of the file.
+int AudioTarget(void){
+    return target;
+}
+
+int AudioUnderruns(void){
+    return SDL_AtomicGet(&ring.underruns);
+}
+
+int AudioOverruns(void){
+    return ring.overruns;
+}
+
+//Roughly how long a sample written now takes to be heard, in milliseconds: what's queued, plus the buffer the device is playing from.
+double AudioLatency(void){
+    if (device == 0){
+        return 0.0;
+    }
+    return 1000.0 * (AudioQueued() + deviceSamples) / audioRate;
+}
+
+//Pace emulation from the sound card's clock instead of the wall clock: wait until the device has played the queue down to the target. Returns how far below the target the queue already was, in performance counter ticks, which is how far emulation has fallen behind.
+Uint64 WaitAudio(void){
+    int excess = AudioQueued() - AudioTarget();
+
+    if (excess < 0){
+        return TimerTicks((double) -excess / audioRate);
+    }
+
+    //The device takes samples a callback's worth at a time, so the queue won't be exactly at the target once this returns. Any difference shows up in the next wait, so it evens out.
+    WaitUntil(TimerNow() + TimerTicks((double) excess / audioRate));
+    return 0;
+}
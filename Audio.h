@@ -0,0 +1,28 @@
+//Samples waiting to be played, passed from the emulation to SDL's audio thread without any locking. There is exactly one writer and one reader, each of which only moves its own count forward. The counts are never wrapped, only their difference matters.
+#define AUDIO_RING_SIZE 8192    //Samples. Must be a power of 2.
+#define AUDIO_DEVICE_SAMPLES 256    //Samples to ask the device to take at a time. It may pick something else.
+
+typedef struct AudioRing{
+    int16_t         samples[AUDIO_RING_SIZE];
+    SDL_atomic_t    readCount;      //Samples taken by the audio callback since the device was opened.
+    SDL_atomic_t    writeCount;     //Samples put in by the emulation.
+    SDL_atomic_t    underruns;      //Callbacks that ran out of samples and had to play silence.
+    int             overruns;       //Writes that didn't fit and had samples dropped. Only touched by the writer.
+    SDL_atomic_t    jitter;         //Furthest a callback has come from when it was expected, in microseconds, since the writer last looked.
+    SDL_atomic_t    suspended;      //Set while nothing is being queued on purpose. Running dry then isn't an underrun.
+    SDL_atomic_t    flushTo;        //Samples the callback should drop the queue down to before it next plays, or -1.
+} AudioRing;
+
+extern int audioRate;
+
+void SetAudioLatency(int, int);
+int OpenAudio(int);
+void CloseAudio(void);
+int WriteAudio(const int16_t *, int);
+void SuspendAudio(int);
+int AudioQueued(void);
+int AudioTarget(void);
+int AudioUnderruns(void);
+int AudioOverruns(void);
+double AudioLatency(void);
+Uint64 WaitAudio(void);
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "Rom.h"
+#include "Bundle.h"
+
+/*
+The bundle is mapped once, whole, and stays mapped until the program exits. Assets are used straight from the mapping: the sound bank plays from it, and the ROM loader checks and copies from it, so nothing is read or decoded at startup but the index.
+Only one bundle can be open at a time.
+*/
+
+static MappedFile bundle = {NULL, 0, 0};
+static const BundleEntry *entries = NULL;
+static uint32_t entryCount = 0;
+
+//Check that the index and every asset fit in the file, so nothing using the bundle has to.
+static int CheckBundle(void){
+    const BundleHeader *header = (const BundleHeader *) bundle.data;
+    uint32_t i = 0;
+
+    if (bundle.size < sizeof(BundleHeader) || memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) != 0){
+        return 1;
+    }
+    if (header->version != BUNDLE_VERSION || header->byteOrder != BUNDLE_BYTE_ORDER){
+        return 1;
+    }
+    if (header->entryCount > (bundle.size - sizeof(BundleHeader)) / sizeof(BundleEntry)){
+        return 1;
+    }
+
+    entries = (const BundleEntry *) (bundle.data + sizeof(BundleHeader));
+    while (i < header->entryCount){
+        const BundleEntry *entry = &entries[i];
+        if (memchr(entry->name, '\0', BUNDLE_NAME_SIZE) == NULL || entry->offset % BUNDLE_ALIGN != 0 || entry->offset > bundle.size || entry->size > bundle.size - entry->offset){
+            return 1;
+        }
+        i++;
+    }
+    entryCount = header->entryCount;
+    return 0;
+}
+
+//Map the bundle. Returns 0 on success.
+int OpenBundle(const char *path){
+    int result = MapFile(path, &bundle);
+
+    if (result == 1){
+        printf("Error: bundle %s not found!\n", path);
+        return 1;
+    }
+    if (result != 0){
+        printf("Error: could not read bundle %s!\n", path);
+        return 1;
+    }
+    if (CheckBundle() != 0){
+        printf("Error: %s is not an asset bundle, or was made by a different version!\n", path);
+        UnmapFile(&bundle);
+        entries = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+//Unmap the bundle. Nothing found in it may be used after this.
+void CloseBundle(void){
+    if (bundle.data != NULL){
+        UnmapFile(&bundle);
+    }
+    entries = NULL;
+    entryCount = 0;
+}
+
+//Returns the asset with the given name and type, or NULL if there's no bundle open or it isn't in it. Its entry goes in *entry.
+const uint8_t *FindAsset(const char *name, int type, const BundleEntry **entry){
+    uint32_t i = 0;
+
+    while (i < entryCount){
+        if (entries[i].type == (uint32_t) type && strcmp(entries[i].name, name) == 0){
+            *entry = &entries[i];
+            return bundle.data + entries[i].offset;
+        }
+        i++;
+    }
+    return NULL;
+}
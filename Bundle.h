@@ -0,0 +1,34 @@
+//Asset bundle: one file holding the ROMs and the decoded sounds, so startup opens one file rather than one per asset. Made by the bundler in Bundler/.
+#define BUNDLE_MAGIC "INVBNDL1"
+#define BUNDLE_VERSION 1
+#define BUNDLE_BYTE_ORDER 0x01020304u   //Written as a native uint32_t, to catch bundles made on a machine of the other endianness.
+#define BUNDLE_ALIGN 4096               //Every asset starts on a page boundary of the file, so it's page aligned in the mapping too.
+#define BUNDLE_NAME_SIZE 24
+
+enum {BUNDLE_ROM, BUNDLE_SOUND};
+
+/*
+File layout: the header, then entryCount entries (the index), then the assets, each at its entry's offset.
+ROM assets are the ROM file as is, named like the file in lower case. Sound assets are named like the file they were decoded from (0.wav...), and are mono floats at the sound's own rate, with padding samples either side of the sound, ready for the resampler: silence, or for the looping UFO sound, the other end of the sound.
+*/
+typedef struct BundleHeader{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    byteOrder;
+    uint32_t    entryCount;
+    uint32_t    reserved;
+} BundleHeader;
+
+typedef struct BundleEntry{
+    char        name[BUNDLE_NAME_SIZE];    //NUL terminated.
+    uint32_t    type;
+    uint32_t    rate;       //Sounds only: sample rate.
+    uint32_t    padding;    //Sounds only: padding samples either side.
+    uint32_t    reserved;
+    uint64_t    offset;     //From the start of the file. A multiple of BUNDLE_ALIGN.
+    uint64_t    size;       //In bytes, padding included.
+} BundleEntry;
+
+int OpenBundle(const char *);
+void CloseBundle(void);
+const uint8_t *FindAsset(const char *, int, const BundleEntry **);
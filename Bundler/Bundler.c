@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "../Bundle.h"
+#include "../Mixer.h"
+#include "../Sound.h"
+
+/*
+Makes an asset bundle for invemu's -bundle option, out of ROM files and sound files:
+
+    Bundler invemu.bundle "Place Game ROMs Here/invaders.h" ... Sounds/0.wav ...
+
+Files ending in .wav are decoded into what the sound bank plays (mono floats at the sound's own rate, padded for the resampler), anything else is taken to be a ROM and stored as is.
+The WAV decoder only reads uncompressed 8 and 16 bit files, which is what the sound files are. Bundles are only good for the resampler they were made for, and on machines of the same endianness; invemu checks both.
+*/
+
+typedef struct Asset{
+    BundleEntry entry;
+    uint8_t     *data;
+} Asset;
+
+static uint32_t ReadLE32(const uint8_t *p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t ReadLE16(const uint8_t *p){
+    return p[0] | (p[1] << 8);
+}
+
+//Read a whole file. Returns NULL if it can't be.
+static uint8_t *ReadFile(const char *path, long *size){
+    FILE *file = fopen(path, "rb");
+    uint8_t *data;
+
+    if (file == NULL){
+        printf("Error: %s not found!\n", path);
+        return NULL;
+    }
+    if (fseek(file, 0L, SEEK_END) != 0 || (*size = ftell(file)) < 0 || fseek(file, 0L, SEEK_SET) != 0){
+        printf("Error: could not read %s!\n", path);
+        fclose(file);
+        return NULL;
+    }
+    data = malloc(*size > 0 ? *size : 1);
+    if (data == NULL || fread(data, 1, *size, file) != (size_t) *size){
+        printf("Error: could not read %s!\n", path);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+//Decode a WAV file the same way the sound bank does when it loads one: mixed down to mono, as floats from -1 to 1, with RESAMPLER_TAPS samples of padding either side. The padding is silence, except for looping sounds, where it comes from the other end of the sound. Returns 0 on success.
+static int DecodeWav(const uint8_t *wav, long size, int loop, Asset *asset){
+    long position = 12;
+    const uint8_t *format = NULL;
+    const uint8_t *pcm = NULL;
+    uint32_t pcmSize = 0;
+    int channels;
+    int bits;
+    int frames;
+    float *samples;
+    int i = 0;
+    int channel;
+
+    if (size < 12 || memcmp(wav, "RIFF", 4) != 0 || memcmp(wav + 8, "WAVE", 4) != 0){
+        return 1;
+    }
+    while (position + 8 <= size){
+        uint32_t chunkSize = ReadLE32(wav + position + 4);
+        if (chunkSize > (uint32_t) (size - position - 8)){
+            chunkSize = (uint32_t) (size - position - 8);
+        }
+        if (memcmp(wav + position, "fmt ", 4) == 0 && chunkSize >= 16){
+            format = wav + position + 8;
+        }
+        else if (memcmp(wav + position, "data", 4) == 0){
+            pcm = wav + position + 8;
+            pcmSize = chunkSize;
+        }
+        position += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (format == NULL || pcm == NULL || ReadLE16(format) != 1){
+        return 1;
+    }
+
+    channels = ReadLE16(format + 2);
+    bits = ReadLE16(format + 14);
+    if (channels < 1 || (bits != 8 && bits != 16)){
+        return 1;
+    }
+    frames = (int) (pcmSize / (channels * bits / 8));
+    if (frames == 0){
+        return 1;
+    }
+
+    samples = calloc(frames + 2 * RESAMPLER_TAPS, sizeof(float));
+    if (samples == NULL){
+        return 1;
+    }
+    while (i < frames){
+        float sum = 0.0f;
+        for (channel = 0; channel < channels; channel++){
+            int index = i * channels + channel;
+            if (bits == 8){
+                sum += (pcm[index] - 128) * (1.0f / 128.0f);
+            }
+            else{
+                sum += (int16_t) ReadLE16(pcm + index * 2) * (1.0f / 32768.0f);
+            }
+        }
+        samples[RESAMPLER_TAPS + i] = sum / channels;
+        i++;
+    }
+
+    i = 0;
+    while (loop && i < RESAMPLER_TAPS){
+        samples[RESAMPLER_TAPS - 1 - i] = samples[RESAMPLER_TAPS + frames - 1 - i % frames];
+        samples[RESAMPLER_TAPS + frames + i] = samples[RESAMPLER_TAPS + i % frames];
+        i++;
+    }
+
+    asset->entry.type = BUNDLE_SOUND;
+    asset->entry.rate = ReadLE32(format + 4);
+    asset->entry.padding = RESAMPLER_TAPS;
+    asset->entry.size = (uint64_t) (frames + 2 * RESAMPLER_TAPS) * sizeof(float);
+    asset->data = (uint8_t *) samples;
+    return 0;
+}
+
+//Load one file into an asset, named after the file in lower case (without the folder). Returns 0 on success.
+static int LoadAsset(const char *path, Asset *asset){
+    const char *name = path;
+    const char *slash;
+    uint8_t *data;
+    long size;
+    size_t length;
+    size_t i = 0;
+    char loopName[16];
+
+    //Both kinds of slash, since on Windows paths can have either.
+    slash = strrchr(name, '/');
+    if (slash != NULL){
+        name = slash + 1;
+    }
+    slash = strrchr(name, '\\');
+    if (slash != NULL){
+        name = slash + 1;
+    }
+    length = strlen(name);
+    if (length == 0 || length >= BUNDLE_NAME_SIZE){
+        printf("Error: %s: file names in a bundle must be 1 to %d characters long!\n", path, BUNDLE_NAME_SIZE - 1);
+        return 1;
+    }
+    memset(&asset->entry, 0, sizeof(asset->entry));
+    while (i < length){
+        asset->entry.name[i] = (char) tolower((unsigned char) name[i]);
+        i++;
+    }
+
+    data = ReadFile(path, &size);
+    if (data == NULL){
+        return 1;
+    }
+
+    if (length > 4 && strcmp(asset->entry.name + length - 4, ".wav") == 0){
+        snprintf(loopName, sizeof(loopName), "%d.wav", SOUND_UFO);
+        if (DecodeWav(data, size, strcmp(asset->entry.name, loopName) == 0, asset) != 0){
+            printf("Error: %s isn't an uncompressed 8 or 16 bit WAV file!\n", path);
+            free(data);
+            return 1;
+        }
+        free(data);
+    }
+    else{
+        asset->entry.type = BUNDLE_ROM;
+        asset->entry.size = (uint64_t) size;
+        asset->data = data;
+    }
+    return 0;
+}
+
+static uint64_t AlignUp(uint64_t offset){
+    return (offset + BUNDLE_ALIGN - 1) / BUNDLE_ALIGN * BUNDLE_ALIGN;
+}
+
+//Write zeros up to the given offset.
+static int PadTo(FILE *file, uint64_t *offset, uint64_t target){
+    static const uint8_t zeros[BUNDLE_ALIGN];
+
+    while (*offset < target){
+        size_t count = target - *offset < sizeof(zeros) ? (size_t) (target - *offset) : sizeof(zeros);
+        if (fwrite(zeros, 1, count, file) != count){
+            return 1;
+        }
+        *offset += count;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    BundleHeader header;
+    Asset *assets;
+    FILE *output;
+    uint64_t offset;
+    int count = argc - 2;
+    int i = 0;
+    int j;
+
+    if (argc < 3){
+        printf("Usage: Bundler output files...\nROM files are stored as they are, .wav files are decoded for the sound bank.\n");
+        return 1;
+    }
+
+    assets = calloc(count, sizeof(Asset));
+    if (assets == NULL){
+        printf("Error: could not allocate memory!\n");
+        return 1;
+    }
+    while (i < count){
+        if (LoadAsset(argv[i + 2], &assets[i]) != 0){
+            return 1;
+        }
+        for (j = 0; j < i; j++){
+            if (assets[j].entry.type == assets[i].entry.type && strcmp(assets[j].entry.name, assets[i].entry.name) == 0){
+                printf("Error: %s is in the bundle twice!\n", assets[i].entry.name);
+                return 1;
+            }
+        }
+        i++;
+    }
+
+    //Lay the assets out after the index, each on a page boundary.
+    offset = AlignUp(sizeof(BundleHeader) + (uint64_t) count * sizeof(BundleEntry));
+    i = 0;
+    while (i < count){
+        assets[i].entry.offset = offset;
+        offset = AlignUp(offset + assets[i].entry.size);
+        i++;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.byteOrder = BUNDLE_BYTE_ORDER;
+    header.entryCount = (uint32_t) count;
+
+    output = fopen(argv[1], "wb");
+    if (output == NULL){
+        printf("Error: could not create %s!\n", argv[1]);
+        return 1;
+    }
+    offset = 0;
+    if (fwrite(&header, sizeof(header), 1, output) != 1){
+        printf("Error: could not write %s!\n", argv[1]);
+        fclose(output);
+        return 1;
+    }
+    offset += sizeof(header);
+    i = 0;
+    while (i < count){
+        if (fwrite(&assets[i].entry, sizeof(BundleEntry), 1, output) != 1){
+            printf("Error: could not write %s!\n", argv[1]);
+            fclose(output);
+            return 1;
+        }
+        offset += sizeof(BundleEntry);
+        i++;
+    }
+    i = 0;
+    while (i < count){
+        if (PadTo(output, &offset, assets[i].entry.offset) != 0 || fwrite(assets[i].data, 1, (size_t) assets[i].entry.size, output) != assets[i].entry.size){
+            printf("Error: could not write %s!\n", argv[1]);
+            fclose(output);
+            return 1;
+        }
+        offset += assets[i].entry.size;
+        printf("%-24s %s, %llu bytes at %llu\n", assets[i].entry.name, assets[i].entry.type == BUNDLE_ROM ? "ROM" : "sound", (unsigned long long) assets[i].entry.size, (unsigned long long) assets[i].entry.offset);
+        free(assets[i].data);
+        i++;
+    }
+    if (fclose(output) != 0){
+        printf("Error: could not write %s!\n", argv[1]);
+        return 1;
+    }
+    free(assets);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "Checksum.h"
+
+//CRC-32 as used by zip files and MAME ROM sets (reflected, polynomial 0xEDB88320), so the results can be compared against published ROM lists.
+uint32_t Crc32(const uint8_t *data, size_t length){
+    return Crc32Update(0, data, length);
+}
+
+//Carry on a CRC-32 over more data. The CRC of two blocks one after the other is Crc32Update(Crc32(first), second), the same as if they were one block.
+uint32_t Crc32Update(uint32_t crc, const uint8_t *data, size_t length){
+    static uint32_t table[256];
+    static int tableReady = 0;
+    size_t i = 0;
+
+    if (tableReady == 0){
+        uint32_t n;
+        int bit;
+        for (n = 0; n < 256; n++){
+            uint32_t value = n;
+            for (bit = 0; bit < 8; bit++){
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320 : value >> 1;
+            }
+            table[n] = value;
+        }
+        tableReady = 1;
+    }
+
+    crc ^= 0xFFFFFFFF;
+    while (i < length){
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        i++;
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+static uint32_t RotateLeft(uint32_t value, int bits){
+    return (value << bits) | (value >> (32 - bits));
+}
+
+//SHA-1 of a block of data, as listed next to the CRC in MAME ROM sets. Not for anything security related, only for telling ROM dumps apart.
+void Sha1(const uint8_t *data, size_t length, uint8_t digest[20]){
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint64_t bits = (uint64_t) length * 8;
+    uint8_t block[64];
+    uint32_t w[80];
+    size_t done = 0;
+    int padded = 0;
+    int last = 0;
+    int i;
+
+    //Whole blocks of data, then one or two blocks with the end of the data, a 1 bit, zeros and the length in bits.
+    while (last == 0){
+        size_t left = length - done;
+        uint32_t a, b, c, d, e;
+
+        if (left >= 64){
+            memcpy(block, data + done, 64);
+            done += 64;
+        }
+        else{
+            memset(block, 0, 64);
+            if (padded == 0){
+                memcpy(block, data + done, left);
+                block[left] = 0x80;
+                padded = 1;
+                done = length;
+            }
+
+            //The length goes in the last 8 bytes, or in one more block if the 1 bit left no room for it.
+            if (left < 56){
+                for (i = 0; i < 8; i++){
+                    block[63 - i] = (bits >> (i * 8)) & 0xFF;
+                }
+                last = 1;
+            }
+        }
+
+        for (i = 0; i < 16; i++){
+            w[i] = ((uint32_t) block[i * 4] << 24) | ((uint32_t) block[i * 4 + 1] << 16) | ((uint32_t) block[i * 4 + 2] << 8) | block[i * 4 + 3];
+        }
+        for (i = 16; i < 80; i++){
+            w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+        for (i = 0; i < 80; i++){
+            uint32_t f, k, temp;
+            if (i < 20){
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40){
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60){
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else{
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            temp = RotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = RotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (i = 0; i < 20; i++){
+        digest[i] = (h[i / 4] >> (24 - (i % 4) * 8)) & 0xFF;
+    }
+}
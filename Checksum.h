@@ -0,0 +1,3 @@
+uint32_t Crc32(const uint8_t *, size_t);
+uint32_t Crc32Update(uint32_t, const uint8_t *, size_t);
+void Sha1(const uint8_t *, size_t, uint8_t [20]);
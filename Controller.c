@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "Controller.h"
+#include "Timing.h"
+
+/*
+Game controller and joystick input.
+A small thread reads the devices and publishes what's held in one atomic word, so a button press is picked up no matter what the emulation loop is doing, and nothing on the CPU side ever calls into SDL to read it.
+SDL has no way to block until a joystick has something new, so with devices plugged in the thread reads them at the rate most controllers report at (every 8 ms), and with none it sleeps until one is plugged in. Plugging and unplugging wake it straight away, through SDL's device events.
+Every transition it sees is timestamped, so the input delay statistics cover each press and release, not just the first one between two frames.
+The first device is player 1 and the second is player 2. With only one device, it controls both players (like the keyboard), since they take turns.
+
+Game controllers (anything SDL has a mapping for):
+    A or B              Fire
+    D-pad or left stick Left/right
+    Start               1P start (2P start on player 2's controller)
+    Back                Insert coin
+Other joysticks: button 0 is fire, button 1 start, button 2 coin, and the first hat or axis moves.
+*/
+
+#define MAX_PLAYERS 2
+#define POLL_MS 8           //USB controllers mostly report every 8 ms (125 Hz), so reading them more often mostly reads the same state again.
+#define MAX_PENDING 32      //Transitions remembered between two takes. Past that, the oldest are merged.
+#define AXIS_DEADZONE 8000
+
+//Port 1 bits in byte 0 and port 2 bits in byte 1 of what's held now. Bytes 2 and 3 have the same for buttons that went down since the word was last taken, so a quick tap isn't missed.
+static SDL_atomic_t controllerState;
+
+//Transitions that haven't been taken yet: the performance counter when each was seen, and how many port bits changed then. The emulation loop uses them to measure input delay. The lock is only ever held for a few instructions.
+static SDL_SpinLock pendingLock = 0;
+static Uint64 pendingTimes[MAX_PENDING];
+static int pendingBits[MAX_PENDING];
+static int pendingCount = 0;
+
+static SDL_atomic_t running;
+static SDL_Thread *thread = NULL;
+static SDL_sem *devicesChanged = NULL;  //Posted when a device is plugged in or out, and to stop the thread.
+static SDL_GameController *controllers[MAX_PLAYERS];
+static SDL_Joystick *joysticks[MAX_PLAYERS];
+static int devices = 0;
+
+//Game bits of one player: fire, left and right, where they sit in port 1 and 2.
+enum {PLAYER_FIRE = 0x10, PLAYER_LEFT = 0x20, PLAYER_RIGHT = 0x40};
+
+static void CloseDevices(void){
+    int i = 0;
+
+    while (i < MAX_PLAYERS){
+        if (controllers[i] != NULL){
+            SDL_GameControllerClose(controllers[i]);
+        }
+        else if (joysticks[i] != NULL){
+            SDL_JoystickClose(joysticks[i]);
+        }
+        controllers[i] = NULL;
+        joysticks[i] = NULL;
+        i++;
+    }
+    devices = 0;
+}
+
+//Open the first two devices. Done again whenever a device is plugged in or out.
+static void OpenDevices(void){
+    int count = SDL_NumJoysticks();
+    int i = 0;
+
+    CloseDevices();
+    while (i < count && devices < MAX_PLAYERS){
+        if (SDL_IsGameController(i)){
+            controllers[devices] = SDL_GameControllerOpen(i);
+            if (controllers[devices] != NULL){
+                devices++;
+            }
+        }
+        else{
+            joysticks[devices] = SDL_JoystickOpen(i);
+            if (joysticks[devices] != NULL){
+                devices++;
+            }
+        }
+        i++;
+    }
+}
+
+//Read one player's device. Returns the game bits, and sets start and coin.
+static uint8_t ReadDevice(int player, int *start, int *coin){
+    uint8_t bits = 0;
+    int x = 0;
+
+    if (controllers[player] != NULL){
+        SDL_GameController *pad = controllers[player];
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_A) || SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_B)){
+            bits |= PLAYER_FIRE;
+        }
+        x = SDL_GameControllerGetAxis(pad, SDL_CONTROLLER_AXIS_LEFTX);
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_DPAD_LEFT)){
+            x = -AXIS_DEADZONE - 1;
+        }
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_DPAD_RIGHT)){
+            x = AXIS_DEADZONE + 1;
+        }
+        *start = SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_START);
+        *coin = SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_BACK);
+    }
+    else if (joysticks[player] != NULL){
+        SDL_Joystick *stick = joysticks[player];
+        if (SDL_JoystickGetButton(stick, 0)){
+            bits |= PLAYER_FIRE;
+        }
+        if (SDL_JoystickNumAxes(stick) > 0){
+            x = SDL_JoystickGetAxis(stick, 0);
+        }
+        if (SDL_JoystickNumHats(stick) > 0){
+            Uint8 hat = SDL_JoystickGetHat(stick, 0);
+            if (hat & SDL_HAT_LEFT){
+                x = -AXIS_DEADZONE - 1;
+            }
+            if (hat & SDL_HAT_RIGHT){
+                x = AXIS_DEADZONE + 1;
+            }
+        }
+        *start = SDL_JoystickNumButtons(stick) > 1 && SDL_JoystickGetButton(stick, 1);
+        *coin = SDL_JoystickNumButtons(stick) > 2 && SDL_JoystickGetButton(stick, 2);
+    }
+
+    if (x < -AXIS_DEADZONE){
+        bits |= PLAYER_LEFT;
+    }
+    if (x > AXIS_DEADZONE){
+        bits |= PLAYER_RIGHT;
+    }
+    return bits;
+}
+
+//What's held on every device, as port bits (port 1 in the low byte, port 2 in the next).
+static uint32_t ReadDevices(void){
+    int start[MAX_PLAYERS] = {0, 0};
+    int coin[MAX_PLAYERS] = {0, 0};
+    uint8_t player1 = ReadDevice(0, &start[0], &coin[0]);
+    uint8_t player2 = ReadDevice(1, &start[1], &coin[1]);
+    uint8_t port1 = player1;
+    uint8_t port2 = devices > 1 ? player2 : player1;
+
+    if (start[0]){
+        port1 |= 0x04;
+    }
+    if (start[1]){
+        port1 |= 0x02;
+    }
+    if (coin[0] || coin[1]){
+        port1 |= 0x01;
+    }
+    return port1 | (port2 << 8);
+}
+
+//Count the bits that changed, which is the number of buttons and directions that went down or up.
+static int CountBits(uint32_t bits){
+    int count = 0;
+
+    while (bits != 0){
+        bits &= bits - 1;
+        count++;
+    }
+    return count;
+}
+
+//Remember when a transition was seen. If the loop hasn't taken the last MAX_PENDING, the newest two are merged, keeping the older time.
+static void AddPending(Uint64 time, int bits){
+    SDL_AtomicLock(&pendingLock);
+    if (pendingCount == MAX_PENDING){
+        pendingBits[MAX_PENDING - 2] += pendingBits[MAX_PENDING - 1];
+        pendingCount--;
+    }
+    pendingTimes[pendingCount] = time;
+    pendingBits[pendingCount] = bits;
+    pendingCount++;
+    SDL_AtomicUnlock(&pendingLock);
+}
+
+//Runs on whichever thread pumped the event: the main loop's, or this one's when it updates the devices.
+static int DeviceWatch(void *data, SDL_Event *event){
+    if (event->type == SDL_JOYDEVICEADDED || event->type == SDL_JOYDEVICEREMOVED){
+        SDL_SemPost(devicesChanged);
+    }
+    return 1;
+}
+
+static int ControllerThread(void *data){
+    uint32_t previous = 0;
+    int rescan = 0;
+
+    while (SDL_AtomicGet(&running)){
+        uint32_t held;
+        uint32_t pressed;
+        int old;
+
+        //The wait is also the poll interval. With nothing plugged in there's nothing to poll, so wait for as long as it takes.
+        if (devices == 0){
+            SDL_SemWait(devicesChanged);
+            rescan = 1;
+        }
+        else if (SDL_SemWaitTimeout(devicesChanged, POLL_MS) == 0){
+            rescan = 1;
+        }
+        if (SDL_AtomicGet(&running) == 0){
+            break;
+        }
+
+        SDL_LockJoysticks();
+        if (rescan){
+            //Several events may have come at once. One look at the device list covers them all.
+            while (SDL_SemTryWait(devicesChanged) == 0){
+            }
+            OpenDevices();
+            rescan = 0;
+        }
+        SDL_GameControllerUpdate();
+        held = ReadDevices();
+        SDL_UnlockJoysticks();
+
+        if (held != previous){
+            //Keep the presses nobody has taken yet, add the new ones.
+            pressed = held & ~previous;
+            do{
+                old = SDL_AtomicGet(&controllerState);
+            } while (SDL_AtomicCAS(&controllerState, old, (int) (held | (((uint32_t) old & 0xFFFF0000) | (pressed << 16)))) == SDL_FALSE);
+
+            AddPending(TimerNow(), CountBits((held ^ previous) & 0xFFFF));
+            previous = held;
+        }
+    }
+
+    SDL_LockJoysticks();
+    CloseDevices();
+    SDL_UnlockJoysticks();
+    return 0;
+}
+
+//Start reading controllers and joysticks in the background. Returns 0 on success.
+int StartControllers(void){
+    //Devices are only read by the thread. Turning their input events off stops them piling up in the main thread's event queue, which doesn't use them. The device events stay on, to wake the thread when something is plugged in.
+    SDL_SetHint(SDL_HINT_JOYSTICK_ALLOW_BACKGROUND_EVENTS, "1");
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) != 0){
+        printf("Error: could not start controller support: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_GameControllerEventState(SDL_IGNORE);
+    SDL_JoystickEventState(SDL_IGNORE);
+    SDL_EventState(SDL_JOYDEVICEADDED, SDL_ENABLE);
+    SDL_EventState(SDL_JOYDEVICEREMOVED, SDL_ENABLE);
+
+    //Starts posted, so the thread opens whatever is plugged in already.
+    devicesChanged = SDL_CreateSemaphore(1);
+    if (devicesChanged == NULL){
+        printf("Error: could not start controller thread: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_AddEventWatch(DeviceWatch, NULL);
+
+    SDL_AtomicSet(&controllerState, 0);
+    pendingCount = 0;
+    SDL_AtomicSet(&running, 1);
+    thread = SDL_CreateThread(ControllerThread, "controllers", NULL);
+    if (thread == NULL){
+        printf("Error: could not start controller thread: %s\n", SDL_GetError());
+        return 1;
+    }
+    return 0;
+}
+
+void StopControllers(void){
+    if (thread != NULL){
+        //The thread may be waiting for a device to be plugged in, so wake it.
+        SDL_AtomicSet(&running, 0);
+        SDL_SemPost(devicesChanged);
+        SDL_WaitThread(thread, NULL);
+        thread = NULL;
+    }
+    if (devicesChanged != NULL){
+        SDL_DelEventWatch(DeviceWatch, NULL);
+        SDL_DestroySemaphore(devicesChanged);
+        devicesChanged = NULL;
+    }
+}
+
+//Get what the controllers have held now and what was pressed since the last call, as bits of input ports 0-2. Returns how long ago each change since the last call happened, added up, in performance counter ticks, and the number of changes (buttons and directions that went down or up) in *events.
+Uint64 TakeControllerInput(uint8_t *held, uint8_t *pressed, int *events){
+    uint32_t state;
+    Uint64 now = TimerNow();
+    Uint64 delay = 0;
+    int old;
+    int i = 0;
+
+    do{
+        old = SDL_AtomicGet(&controllerState);
+    } while (SDL_AtomicCAS(&controllerState, old, old & 0xFFFF) == SDL_FALSE);
+    state = (uint32_t) old;
+
+    held[0] = 0;
+    held[1] = state & 0xFF;
+    held[2] = (state >> 8) & 0xFF;
+    pressed[0] = 0;
+    pressed[1] = (state >> 16) & 0xFF;
+    pressed[2] = (state >> 24) & 0xFF;
+
+    *events = 0;
+    SDL_AtomicLock(&pendingLock);
+    while (i < pendingCount){
+        delay += (now - pendingTimes[i]) * pendingBits[i];
+        *events += pendingBits[i];
+        i++;
+    }
+    pendingCount = 0;
+    SDL_AtomicUnlock(&pendingLock);
+    return delay;
+}
@@ -0,0 +1,3 @@
+int StartControllers(void);
+void StopControllers(void);
+Uint64 TakeControllerInput(uint8_t *, uint8_t *, int *);
@@ -5,12 +5,146 @@
 #include <stdint.h>
 #include "8080Emulator.h"
 #include <SDL.h>
-#include <SDL_mixer.h>
+#include "InvadersMachine.h"
+#include "Overlay.h"
+#include "Stats.h"
+#include "Sound.h"
+#include "Machines.h"
+
+extern const int cpmflag;
+
+#define MAX_RAM_BLOCKS 8
+
+//Bytes per pixel of the screen texture.
+static int screenPixelSize = 4;
+
+//Set when the window's contents have been lost (uncovered, restored, resized), so the next render draws and presents even though the picture hasn't changed.
+int redrawScreen = 0;
+
+typedef uint8_t (*InHandler)(State8080 *, uint8_t);
+typedef void (*OutHandler)(State8080 *, uint8_t);
+
+//The game being run, and the tables SelectMachine builds from its description. MemWrite sends a write to writeMap[page] plus the offset within the page, and IN and OUT call the port's handler, so none of them need to know which game it is.
+const MachineDescription *machine;
+uint32_t writeMap[256];
+static InHandler inHandlers[256];
+static OutHandler outHandlers[256];
+static uint8_t soundSlot[256];          //Which of the description's sound ports each port is.
+static uint32_t soundStarts[2][256];    //Sounds started and stopped by each pattern of bits going from 0 to 1 (starts) or 1 to 0 (stops) on a sound port.
+static uint32_t soundStops[2][256];
+static uint16_t ramStarts[MAX_RAM_BLOCKS];  //The RAM behind the regions, once each however many times it's mirrored, which is what snapshots and hashes cover.
+static uint32_t ramSizes[MAX_RAM_BLOCKS];
+static int ramBlockCount;
+
+static void ScheduleFrame(InvadersIO *);
+static uint8_t ReadNothing(State8080 *, uint8_t);
+static uint8_t ReadInput(State8080 *, uint8_t);
+static uint8_t ReadShiftResult(State8080 *, uint8_t);
+static void WriteNothing(State8080 *, uint8_t);
+static void WriteShiftAmount(State8080 *, uint8_t);
+static void WriteShiftData(State8080 *, uint8_t);
+static void WriteSound(State8080 *, uint8_t);
+static void WriteSoundShadow(State8080 *, uint8_t);
+
+//Build the memory and port tables for a game. Must be called before any machine is set up, and can't change once one is running.
+void SelectMachine(const MachineDescription *description){
+    int page;
+    int region = 0;
+    int block;
+    uint32_t ramTotal = 0;
+    int slot = 0;
+    int port;
+    int value;
+    int bit;
+
+    machine = description;
+    ramBlockCount = 0;
+
+    //Writes are dropped unless a region takes them. The CP/M diagnostics treat the whole address space as RAM.
+    for (page = 0; page < 256; page++){
+        writeMap[page] = cpmflag ? (uint32_t) page << 8 : DISCARD_PAGE;
+    }
+    while (region < description->regionCount && cpmflag == 0){
+        const WriteRegion *r = &description->regions[region];
+        for (page = r->start >> 8; page <= r->end >> 8; page++){
+            writeMap[page] = r->target + ((page << 8) & r->mask);
+        }
+
+        //A region whose target is already a block is a mirror of it.
+        block = 0;
+        while (block < ramBlockCount && ramStarts[block] != r->target){
+            block++;
+        }
+        if (block == ramBlockCount){
+            if (ramBlockCount == MAX_RAM_BLOCKS || ramTotal + r->mask + 1 > SNAPSHOT_RAM_SIZE){
+                printf("Error: %s has more RAM than a snapshot holds!\n", description->name);
+            }
+            else{
+                ramStarts[ramBlockCount] = r->target;
+                ramSizes[ramBlockCount] = r->mask + 1;
+                ramTotal += r->mask + 1;
+                ramBlockCount++;
+            }
+        }
+        region++;
+    }
 
-static uint16_t shiftRegister;
-static uint8_t shiftOffset;
+    for (port = 0; port < 256; port++){
+        inHandlers[port] = ReadNothing;
+        outHandlers[port] = WriteNothing;
+    }
+    for (port = 0; port < 3; port++){
+        inHandlers[port] = ReadInput;
+    }
+    inHandlers[description->shiftResultPort] = ReadShiftResult;
+    outHandlers[description->shiftAmountPort] = WriteShiftAmount;
+    outHandlers[description->shiftDataPort] = WriteShiftData;
+
+    while (slot < 2){
+        const SoundPort *sound = &description->soundPorts[slot];
+        outHandlers[sound->port] = sound->shadow != 0 ? WriteSoundShadow : WriteSound;
+        soundSlot[sound->port] = slot;
+        for (value = 0; value < 256; value++){
+            soundStarts[slot][value] = 0;
+            soundStops[slot][value] = 0;
+            for (bit = 0; bit < 8; bit++){
+                if ((value >> bit & 0x1) && sound->sounds[bit] >= 0){
+                    soundStarts[slot][value] |= 1u << sound->sounds[bit];
+                    if (sound->stopMask >> bit & 0x1){
+                        soundStops[slot][value] |= 1u << sound->sounds[bit];
+                    }
+                }
+            }
+        }
+        slot++;
+    }
+}
+
+void InitIO(InvadersIO *io){
+    io->frame = 0;
+    io->clockFrame = 0;
+    io->clockCycle = 0;
+    io->clockMultiplier = 1;
+    io->overran = 0;
+    io->interrupts = 0;
+    io->overruns = 0;
+    InitScheduler(&io->scheduler);
+    ScheduleFrame(io);
+    io->shiftRegister = 0;
+    io->shiftOffset = 0;
+    io->prevSound[0] = machine->soundPorts[0].initial;
+    io->prevSound[1] = machine->soundPorts[1].initial;
+    io->inputEnabled = 1;
+    io->soundEnabled = 1;
+    io->sound = NULL;
+    io->latchInput = 0;
+    ReleaseInput(io);
+    LatchInput(io);
+}
 
 void Interrupt(State8080* state, FILE *output, int *instruction, int number){
+    //Accepting an interrupt disables further ones until the handler runs EI, like on the real 8080.
+    state->int_enable = 0;
 
     switch (number){
 
@@ -20,17 +154,17 @@ void Interrupt(State8080* state, FILE *output, int *instruction, int number){
         state->memory[state->sp - 1 & 0xFFFF] = ((state->pc) >> 8) & 0xff;
         state->memory[state->sp - 2 & 0xFFFF] = (state->pc) & 0xff;
         state->sp -= 2;
-        state->pc = 0x8;
+        state->pc = machine->vectors[0];
         state->cyclecount += 11;
         break;
 
     //End-screen interrupt (scan line 224).
     case 2:
-        //Same as case 1, except go to instruction 0x10.
+        //Same as case 1, except for where it goes (0x10 on every game so far).
         state->memory[state->sp - 1 & 0xFFFF] = ((state->pc) >> 8) & 0xff;
         state->memory[state->sp - 2 & 0xFFFF] = (state->pc) & 0xff;
         state->sp -= 2;
-        state->pc = 0x10;
+        state->pc = machine->vectors[1];
         state->cyclecount += 11;
         break;
     default:
@@ -40,259 +174,428 @@ void Interrupt(State8080* state, FILE *output, int *instruction, int number){
     return;
 }
 
-uint8_t ProcessorIN(State8080* state, uint8_t port){
-    uint8_t processorInput;
-
-    //Get keyboard input.
-    SDL_Event keyPress;
-    SDL_PollEvent(&keyPress);
-
-    switch (port){
-        case 0:
-        /*
-        //port = port | 0x0E; //bit 1-3 are always 1: 0000 1110
-        //If firing, set bit 4.
-        //If left input, set bit 5.
-        //If right input, set bit 6.
-        bit 0 = DIP4 (not sure what this does).
-        bit 1 = Always 1
-        bit 2 = Always 1
-        bit 3 = Always 1
-        bit 4 = Fire
-        bit 5 = Left
-        bit 6 = Right
-        bit 7 = Tied to demux port 7 (not sure what this does).
-        */
-
-        //Set bits 1-3.
-        processorInput = 0x0E;
-        break;
+void SaveSnapshot(State8080 *state, MachineSnapshot *snapshot){
+    uint8_t *ram = snapshot->ram;
+    int block = 0;
 
-        case 1:
-        /*
-        bit 0 = Insert coin (1 if deposit)
-        bit 1 = 2P start (1 if pressed)
-        bit 2 = 1P start (1 if pressed)
-        bit 3 = Always 1
-        bit 4 = 1P shot (1 if pressed)
-        bit 5 = 1P left (1 if pressed)
-        bit 6 = 1P right (1 if pressed)
-        bit 7 = not connected
-        */
-
-        //Bit 3 is always 1
-        processorInput = 0x8;
-
-        //Check state of keyboard. The function returns an array, with each key on the keyboard as its index, so the array (pointer) + SDL_SCANCODE_C is the index corresponding to the c character on the keyboard.
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_C) == 1){
-            processorInput |= 0x1;
-        }
+    snapshot->cpu = *state;
+    snapshot->io = *(InvadersIO *) state->io;
+    while (block < ramBlockCount){
+        memcpy(ram, &state->memory[ramStarts[block]], ramSizes[block]);
+        ram += ramSizes[block];
+        block++;
+    }
+}
 
-        //2 Player mode.
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_2) == 1){
-            processorInput |= 0x2;
-        }
+void LoadSnapshot(State8080 *state, const MachineSnapshot *snapshot){
+    uint8_t *memory = state->memory;
+    InvadersIO *io = state->io;
+    const uint8_t *ram = snapshot->ram;
+    int block = 0;
+
+    //The snapshot's memory and io pointers belong to the machine it was taken from. Keep this machine's own.
+    *state = snapshot->cpu;
+    state->memory = memory;
+    state->io = io;
+    *io = snapshot->io;
+    while (block < ramBlockCount){
+        memcpy(&memory[ramStarts[block]], ram, ramSizes[block]);
+        ram += ramSizes[block];
+        block++;
+    }
+}
 
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_RETURN) == 1){
-            processorInput |= 0x4;
-        }
+//Cycle count at which a frame starts. Computed from the frame number rather than by adding up 33333s, so that 2 MHz / 60 not being a whole number doesn't make the timing drift. Frames before the last change of clock multiplier aren't covered.
+uint64_t FrameStartCycle(InvadersIO *io, uint64_t frame){
+    return io->clockCycle + (frame - io->clockFrame) * CPU_CLOCK * io->clockMultiplier / FRAME_RATE;
+}
 
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_SPACE) == 1){
-            processorInput |= 0x10;
-        }
+//Run the CPU at a multiple of its real clock from the current frame on. The interrupts keep coming 120 times a second, so the game runs at the same speed but gets more cycles to do its work in, like an overclocked board. Only call between frames, after VBlank.
+void SetClockMultiplier(InvadersIO *io, int multiplier){
+    if (multiplier < 1 || multiplier > MAX_CLOCK_MULTIPLIER){
+        printf("Error: invalid clock multiplier!\n");
+        return;
+    }
+
+    io->clockCycle = FrameStartCycle(io, io->frame);
+    io->clockFrame = io->frame;
+    io->clockMultiplier = multiplier;
 
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_LEFT) == 1){
-            processorInput |= 0x20;
+    CancelEvent(&io->scheduler, EVENT_MIDSCREEN);
+    CancelEvent(&io->scheduler, EVENT_VBLANK);
+    ScheduleFrame(io);
+}
+
+//Schedule the interrupts for the current frame.
+static void ScheduleFrame(InvadersIO *io){
+    uint64_t start = FrameStartCycle(io, io->frame);
+    uint64_t end = FrameStartCycle(io, io->frame + 1);
+
+    ScheduleEvent(&io->scheduler, start + (end - start) / 2, EVENT_MIDSCREEN);
+    ScheduleEvent(&io->scheduler, end, EVENT_VBLANK);
+}
+
+//Run instructions until the cycle count reaches the given time. The last instruction may go past it, the extra cycles simply count towards what comes next.
+void RunCPU(State8080 *state, uint64_t until){
+    while (state->cyclecount < until){
+        Emulate8080Op(state, NULL);
+    }
+}
+
+//Handle the earliest scheduled event, which must be due. Returns the type of the event, or EVENT_NONE if nothing visible happened and the caller has nothing to do.
+int HandleNextEvent(State8080 *state){
+    InvadersIO *io = state->io;
+    ScheduledEvent event = PopEvent(&io->scheduler);
+
+    switch (event.type){
+        case EVENT_MIDSCREEN:
+        case EVENT_VBLANK:
+        //While the game has interrupts disabled, the interrupt stays pending and is retried after every instruction until it gets through. Nothing is lost by the wait: the next frame is scheduled from the frame's own start, not from when the interrupt went through.
+        //Once the game is up and running, that means it is still busy with the last interrupt (or has them disabled for some other reason), so it has overrun its budget for the frame.
+        if (state->int_enable == 0){
+            ScheduleEvent(&io->scheduler, state->cyclecount + 1, event.type);
+            io->overran = (io->interrupts > 0);
+            return EVENT_NONE;
+        }
+        //Nothing has run since EI yet, so interrupts aren't on yet either. The next instruction always runs first, which is no overrun.
+        if (state->cyclecount == state->ei_cycle){
+            ScheduleEvent(&io->scheduler, state->cyclecount + 1, event.type);
+            return EVENT_NONE;
         }
+        io->interrupts++;
 
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_RIGHT) == 1){
-            processorInput |= 0x40;
+        if (event.type == EVENT_MIDSCREEN){
+            Interrupt(state, NULL, NULL, 1);
+            if (io->latchInput == 0){
+                LatchInput(io);
+            }
+        }
+        else{
+            Interrupt(state, NULL, NULL, 2);
+            io->overruns += io->overran;
+            io->overran = 0;
+            io->frame++;
+            ScheduleFrame(io);
+            LatchInput(io);
         }
         break;
+    }
+    return event.type;
+}
 
-        case 2:
-        /*
-        bit 0 = + 1 extra ship if enabled (3 by default).
-        bit 1 = + 2 extra ships if enabled
-        bit 2 = Tilt (not sure what this does).
-        bit 3 = 0 = extra ship at 1500 points, 1 = extra ship at 1000 points.
-        bit 4 = 2P shot (1 if pressed)
-        bit 5 = 2P left  (1 if pressed)
-        bit 6 = 2P right (1 if pressed)
-        bit 7 = Coin info displayed in demo screen (asks user to insert coin). 0 = On, 1 = off.
-        */
-
-        //Set bit 0, 1, and 3.
-        processorInput = 0xB;
-
-        //Tilt. Causes game over.
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_T) == 1){
-            processorInput |= 0x4;
-        }
+//Run one whole frame without any waiting, up to and including the VBlank interrupt. Used when several machines are run together and paced as a group.
+void EmulateFrame(State8080 *state){
+    InvadersIO *io = state->io;
+    int event = EVENT_NONE;
 
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_SPACE) == 1){
-            processorInput |= 0x10;
-        }
+    while (event != EVENT_VBLANK){
+        RunCPU(state, NextEventTime(&io->scheduler));
+        event = HandleNextEvent(state);
+    }
+}
 
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_LEFT) == 1){
-            processorInput |= 0x20;
-        }
+/*
+Input ports, as the game sees them.
+
+Port 0:
+bit 0 = DIP4 (not sure what this does).
+bit 1 = Always 1
+bit 2 = Always 1
+bit 3 = Always 1
+bit 4 = Fire
+bit 5 = Left
+bit 6 = Right
+bit 7 = Tied to demux port 7 (not sure what this does).
+
+Port 1:
+bit 0 = Insert coin (1 if deposit)
+bit 1 = 2P start (1 if pressed)
+bit 2 = 1P start (1 if pressed)
+bit 3 = Always 1
+bit 4 = 1P shot (1 if pressed)
+bit 5 = 1P left (1 if pressed)
+bit 6 = 1P right (1 if pressed)
+bit 7 = not connected
+
+Port 2:
+bit 0 = + 1 extra ship if enabled (3 by default).
+bit 1 = + 2 extra ships if enabled
+bit 2 = Tilt (causes game over).
+bit 3 = 0 = extra ship at 1500 points, 1 = extra ship at 1000 points.
+bit 4 = 2P shot (1 if pressed)
+bit 5 = 2P left  (1 if pressed)
+bit 6 = 2P right (1 if pressed)
+bit 7 = Coin info displayed in demo screen (asks user to insert coin). 0 = On, 1 = off.
+*/
+
+//What ports 0-2 read with nothing pressed comes from the machine description. For Space Invaders, port 0 has bits 1-3 set, port 1 bit 3, and port 2 sets the DIP switches for 6 ships and an extra ship at 1000 points. The other games are wired the same way, and get the same values.
+
+//Which port bit each key sets. The fire and arrow keys work for both players.
+static const struct {
+    SDL_Scancode    key;
+    uint8_t         port;
+    uint8_t         bit;
+} keyMap[] = {
+    {SDL_SCANCODE_C, 1, 0x01},
+    {SDL_SCANCODE_2, 1, 0x02},
+    {SDL_SCANCODE_RETURN, 1, 0x04},
+    {SDL_SCANCODE_SPACE, 1, 0x10},
+    {SDL_SCANCODE_LEFT, 1, 0x20},
+    {SDL_SCANCODE_RIGHT, 1, 0x40},
+    {SDL_SCANCODE_T, 2, 0x04},
+    {SDL_SCANCODE_SPACE, 2, 0x10},
+    {SDL_SCANCODE_LEFT, 2, 0x20},
+    {SDL_SCANCODE_RIGHT, 2, 0x40}
+};
+
+//Feed a key going down or up to the machine. Called by the host's event loop, never from the CPU. Keys that don't control the game are ignored.
+void InputKey(InvadersIO *io, SDL_Scancode key, int down){
+    size_t i = 0;
+
+    if (io->inputEnabled == 0){
+        return;
+    }
 
-        if (*(SDL_GetKeyboardState(NULL) + SDL_SCANCODE_RIGHT) == 1){
-            processorInput |= 0x40;
+    while (i < sizeof(keyMap) / sizeof(keyMap[0])){
+        if (keyMap[i].key == key){
+            if (down){
+                io->inputHeld[keyMap[i].port] |= keyMap[i].bit;
+                io->inputPressed[keyMap[i].port] |= keyMap[i].bit;
+            }
+            else{
+                io->inputHeld[keyMap[i].port] &= ~keyMap[i].bit;
+            }
         }
+        i++;
+    }
+}
 
-        break;
+//Feed the controllers' state to the machine: port bits held now, and pressed since the last call. Like InputKey, called by the host, never from the CPU.
+void InputController(InvadersIO *io, const uint8_t *held, const uint8_t *pressed){
+    int port = 0;
 
-        case 3: //Bit shift register read.
-        processorInput = (shiftRegister >> (8 - shiftOffset)) & 0xFF; //Output contents of right byte, after shifting the register by 8 - offset.
-        break;
+    if (io->inputEnabled == 0){
+        return;
     }
 
-    //Goes to A register (accumulator).
-    return processorInput;
+    while (port < 3){
+        io->padHeld[port] = held[port];
+        io->inputPressed[port] |= pressed[port];
+        port++;
+    }
+}
+
+//Let go of every key and button, for when the machine stops getting input.
+void ReleaseInput(InvadersIO *io){
+    memset(io->inputHeld, 0, sizeof(io->inputHeld));
+    memset(io->padHeld, 0, sizeof(io->padHeld));
+    memset(io->inputPressed, 0, sizeof(io->inputPressed));
+}
+
+//Update what the input ports read from the keys held now. A key that was pressed and let go again since the last time still shows as pressed this once, so short taps aren't lost between samples.
+void LatchInput(InvadersIO *io){
+    int port = 0;
+
+    while (port < 3){
+        io->inputPorts[port] = machine->idleInput[port] | io->inputHeld[port] | io->padHeld[port] | io->inputPressed[port];
+        io->inputPressed[port] = 0;
+        port++;
+    }
+}
+
+uint8_t ProcessorIN(State8080* state, uint8_t port){
+    return inHandlers[port](state, port);
 }
 
 void ProcessorOUT(State8080* state, uint8_t port){
-    switch (port){
-        case 2: //Shift amount (3 bits).
-        shiftOffset = state->a & 0x07; //Mask out the 3 rightmost bits (bit 0-2), since they determine how much to shift by.
-        break;
-        case 3:
-        /*
-        bit 0 = UFO (repeats)
-        bit 1 = Shot
-        bit 2 = Flash (player death)
-        bit 3 = Invader death
-        bit 4 = Extended play (extra life sound)
-        bit 5 = AMP enable
-        bit 6 = NC (not wired)
-        bit 7 = NC (not wired)
-        */
-
-        //Volume
-        Mix_MasterVolume(40);
-        Mix_VolumeMusic(40);
-
-        //Get the previous value in the sound 3 port. If the relevant bit has gone from 0 to 1, play a sound.
-        static uint8_t prevSoundPort3 = 0;
-
-        //UFO sound. Loops until destroyed or it disappears.
-        if (state->memory[0x2094] & 0x1 && ((prevSoundPort3 & 0x1) == 0)){
-            static Mix_Music *UFOsound;
-            if (UFOsound == NULL){
-                UFOsound = Mix_LoadMUS("Sounds\\0.wav");
-            }
-            Mix_PlayMusic(UFOsound, 30);
-        }
-        if ((state->memory[0x2094] & 0x1) == 0 && ((prevSoundPort3 & 0x1) == 1)){
-            Mix_HaltMusic();
-        }
+    outHandlers[port](state, port);
+}
 
-        //Check if the sound bit in memory is enabled. If it is, and the previous value was disabled (i.e no sound was playing), play the sound.
-        if (state->memory[0x2094] & 0x2 && ((prevSoundPort3 & 0x2) == 0)){
-            static Mix_Chunk *sound1;
-            //Load sound if it hasn't been loaded yet.
-            if (sound1 == NULL){
-                sound1 = Mix_LoadWAV("Sounds\\1.wav");
-            }
-            //Play the sound.
-            Mix_PlayChannel(-1, sound1, 0);
-            //Note that the chunk storing a specific sound is never freed (until program ends of course), but this does not cause memory leaks since each sound is only loaded once.
-        }
+//Ports nothing is wired to read 0, and writes to them (the watchdog included) do nothing.
+static uint8_t ReadNothing(State8080 *state, uint8_t port){
+    return 0;
+}
 
-        if (state->memory[0x2094] & 0x4 && ((prevSoundPort3 & 0x4) == 0)){
-            static Mix_Chunk *sound2;
-            if (sound2 == NULL){
-                sound2 = Mix_LoadWAV("Sounds\\2.wav");
-            }
-            Mix_PlayChannel(-1, sound2, 0);
-        }
+static void WriteNothing(State8080 *state, uint8_t port){
+}
 
-        if (state->memory[0x2094] & 0x8 && ((prevSoundPort3 & 0x8) == 0)){
-            static Mix_Chunk *sound3;
-            if (sound3 == NULL){
-                sound3 = Mix_LoadWAV("Sounds\\3.wav");
-            }
-            Mix_PlayChannel(-1, sound3, 0);
-        }
+//Ports 0-2 were latched at the last interrupt, so reading them is just a load.
+static uint8_t ReadInput(State8080 *state, uint8_t port){
+    InvadersIO *io = state->io;
+    return io->inputPorts[port];
+}
 
-        if (state->memory[0x2094] & 0x10 && ((prevSoundPort3 & 0x10) == 0)){
-            static Mix_Chunk *sound9;
-            if (sound9 == NULL){
-                sound9 = Mix_LoadWAV("Sounds\\9.wav");
-            }
-            Mix_PlayChannel(-1, sound9, 0);
-        }
+//Bit shift register read. Output contents of right byte, after shifting the register by 8 - offset. Goes to A register (accumulator).
+static uint8_t ReadShiftResult(State8080 *state, uint8_t port){
+    InvadersIO *io = state->io;
+    return (io->shiftRegister >> (8 - io->shiftOffset)) & 0xFF;
+}
 
-        prevSoundPort3 = state->memory[0x2094];
-        break;
-        case 4: //Shift data.
-        shiftRegister >>= 8; //Shift previous input to the right by 8 bits to make room in the left byte for the new data.
-        shiftRegister = (state->a << 8) | shiftRegister; //Load new data into leftmost byte.
-        break;
-        case 5:
-        /*
-        bit 0 = Fleet movement 1
-        bit 1 = Fleet movement 2
-        bit 2 = Fleet movement 3
-        bit 3 = Fleet movement 4
-        bit 4 = UFO Hit
-        bit 5 = NC (Cocktail mode control, to flip screen (unused))
-        bit 6 = NC (not wired)
-        bit 7 = NC (not wired)
-        */
-
-        static uint8_t prevSoundPort5 = 1; //Plays alien move sound on startup if not set to 1, because game sets RAM register 0x2098 to 1 for some reason.
-
-        //Start audio. Runs at the beginning of the game due to the alien move sound on startup mentioned above. Note: move this to invemu.c.
-        Mix_OpenAudio(48000, MIX_DEFAULT_FORMAT, 2, 1024);
-
-        if (state->memory[0x2098] & 0x1 && ((prevSoundPort5 & 0x1) == 0)){
-            static Mix_Chunk *sound4;
-            if (sound4 == NULL){
-                sound4 = Mix_LoadWAV("Sounds\\4.wav");
-            }
-            Mix_PlayChannel(-1, sound4, 0);
-        }
+//Shift amount (3 bits).
+static void WriteShiftAmount(State8080 *state, uint8_t port){
+    InvadersIO *io = state->io;
+    io->shiftOffset = state->a & 0x07; //Mask out the 3 rightmost bits (bit 0-2), since they determine how much to shift by.
+}
 
-        if (state->memory[0x2098] & 0x2 && ((prevSoundPort5 & 0x2) == 0)){
-            static Mix_Chunk *sound5;
-            if (sound5 == NULL){
-                sound5 = Mix_LoadWAV("Sounds\\5.wav");
-            }
-            Mix_PlayChannel(-1, sound5, 0);
-        }
+//Shift data.
+static void WriteShiftData(State8080 *state, uint8_t port){
+    InvadersIO *io = state->io;
+    io->shiftRegister >>= 8; //Shift previous input to the right by 8 bits to make room in the left byte for the new data.
+    io->shiftRegister = (state->a << 8) | io->shiftRegister; //Load new data into leftmost byte.
+}
 
-        if (state->memory[0x2098] & 0x4 && ((prevSoundPort5 & 0x4) == 0)){
-            static Mix_Chunk *sound6;
-            if (sound6 == NULL){
-                sound6 = Mix_LoadWAV("Sounds\\6.wav");
-            }
-            Mix_PlayChannel(-1, sound6, 0);
-        }
+/*
+Sound ports. On Space Invaders:
+
+Port 3:
+bit 0 = UFO (repeats)
+bit 1 = Shot
+bit 2 = Flash (player death)
+bit 3 = Invader death
+bit 4 = Extended play (extra life sound)
+bit 5 = AMP enable
+bit 6 = NC (not wired)
+bit 7 = NC (not wired)
+
+Port 5:
+bit 0 = Fleet movement 1
+bit 1 = Fleet movement 2
+bit 2 = Fleet movement 3
+bit 3 = Fleet movement 4
+bit 4 = UFO Hit
+bit 5 = NC (Cocktail mode control, to flip screen (unused))
+bit 6 = NC (not wired)
+bit 7 = NC (not wired)
+
+Sounds start when their bit goes from 0 to 1, and looping sounds (the UFO) stop when it goes back to 0. Which sound each bit is comes from the machine description, looked up in the tables SelectMachine built.
+*/
+static void PlaySoundPort(State8080 *state, int slot, uint8_t value){
+    InvadersIO *io = state->io;
+
+    if (io->soundEnabled){
+        uint8_t rising = value & ~io->prevSound[slot];
+        uint8_t falling = ~value & io->prevSound[slot];
+        QueueSounds(io->sound, state->cyclecount, soundStarts[slot][rising], soundStops[slot][falling]);
+    }
+    io->prevSound[slot] = value;
+}
 
-        if (state->memory[0x2098] & 0x8 && ((prevSoundPort5 & 0x8) == 0)){
-            static Mix_Chunk *sound7;
-            if (sound7 == NULL){
-                sound7 = Mix_LoadWAV("Sounds\\7.wav");
-            }
-            Mix_PlayChannel(-1, sound7, 0);
+static void WriteSound(State8080 *state, uint8_t port){
+    PlaySoundPort(state, soundSlot[port], state->a);
+}
+
+//For games whose sound is taken from the copy of the port they keep in RAM.
+static void WriteSoundShadow(State8080 *state, uint8_t port){
+    int slot = soundSlot[port];
+    PlaySoundPort(state, slot, state->memory[machine->soundPorts[slot].shadow]);
+}
+
+//Cheap fingerprint of the VRAM (0x2400 - 0x3FFF), used to tell whether the picture has changed since the last time it was drawn. FNV-1a, 8 bytes at a time.
+uint64_t VRAMHash(const uint8_t *memory){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint64_t word;
+    int i = 0;
+
+    while (i < 0x1c00){
+        memcpy(&word, &memory[0x2400 + i], sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        i += 8;
+    }
+    return hash;
+}
+
+//Fingerprint of everything that can differ between two runs of the game: the RAM (all of it the game can write, colour RAM included), the CPU registers, the cycle count and where the CPU is with EI, and the board (shift register, what the sound and input ports hold, the clock and the pending interrupts). Two deterministic runs given the same input must end up with the same hash, which makes it useful for regression checks.
+//Not included: the host's keys and controllers, which only reach the machine through the input ports, and the counters kept for -stats.
+uint64_t MachineHash(State8080 *state){
+    InvadersIO *io = state->io;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint64_t word;
+    uint8_t registers[16];
+    uint8_t board[16];
+    int block = 0;
+    int event = 0;
+    uint32_t i;
+
+    while (block < ramBlockCount){
+        i = 0;
+        while (i < ramSizes[block]){
+            memcpy(&word, &state->memory[ramStarts[block] + i], sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ULL;
+            i += 8;
         }
+        block++;
+    }
 
-        if (state->memory[0x2098] & 0x10 && ((prevSoundPort5 & 0x10) == 0)){
-            static Mix_Chunk *sound8;
-            if (sound8 == NULL){
-                sound8 = Mix_LoadWAV("Sounds\\8.wav");
+    //Registers are copied out one by one, since the struct has padding and pointers in it.
+    registers[0] = state->a;
+    registers[1] = state->b;
+    registers[2] = state->c;
+    registers[3] = state->d;
+    registers[4] = state->e;
+    registers[5] = state->h;
+    registers[6] = state->l;
+    registers[7] = state->sp & 0xFF;
+    registers[8] = state->sp >> 8;
+    registers[9] = state->pc & 0xFF;
+    registers[10] = state->pc >> 8;
+    registers[11] = state->cc.z | (state->cc.s << 1) | (state->cc.p << 2) | (state->cc.cy << 3) | (state->cc.ac << 4);
+    registers[12] = state->int_enable;
+    registers[13] = registers[14] = registers[15] = 0;
+
+    board[0] = io->shiftRegister & 0xFF;
+    board[1] = io->shiftRegister >> 8;
+    board[2] = io->shiftOffset;
+    board[3] = io->prevSound[0];
+    board[4] = io->prevSound[1];
+    board[5] = io->inputPorts[0];
+    board[6] = io->inputPorts[1];
+    board[7] = io->inputPorts[2];
+    board[8] = io->clockMultiplier;
+    board[9] = io->overran;
+    memset(&board[10], 0, 6);
+
+    i = 0;
+    while (i < 16){
+        memcpy(&word, &registers[i], sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        memcpy(&word, &board[i], sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        i += 8;
+    }
+    hash = (hash ^ state->ei_cycle) * 0x100000001b3ULL;
+    hash = (hash ^ io->frame) * 0x100000001b3ULL;
+    hash = (hash ^ io->clockFrame) * 0x100000001b3ULL;
+    hash = (hash ^ io->clockCycle) * 0x100000001b3ULL;
+    while (event < io->scheduler.count){
+        hash = (hash ^ io->scheduler.events[event].time) * 0x100000001b3ULL;
+        hash = (hash ^ (uint64_t) io->scheduler.events[event].type) * 0x100000001b3ULL;
+        event++;
+    }
+    return (hash ^ state->cyclecount) * 0x100000001b3ULL;
+}
+
+//Create the texture the screen is uploaded to. SDL2 has no palettised textures, so the smallest format the renderer supports natively is used instead: RGB332 (1 byte per pixel), then RGB565 (2 bytes), then RGBA32 (4 bytes). Formats the renderer would have to convert in software are skipped, since that conversion costs more than it saves.
+SDL_Texture *CreateScreenTexture(SDL_Renderer *renderer){
+    SDL_RendererInfo info;
+    Uint32 format = SDL_PIXELFORMAT_RGBA32;
+    Uint32 i = 0;
+
+    screenPixelSize = 4;
+    if (SDL_GetRendererInfo(renderer, &info) == 0){
+        while (i < info.num_texture_formats){
+            if (info.texture_formats[i] == SDL_PIXELFORMAT_RGB332){
+                format = SDL_PIXELFORMAT_RGB332;
+                screenPixelSize = 1;
             }
-            Mix_PlayChannel(-1, sound8, 0);
+            else if (info.texture_formats[i] == SDL_PIXELFORMAT_RGB565 && screenPixelSize > 2){
+                format = SDL_PIXELFORMAT_RGB565;
+                screenPixelSize = 2;
+            }
+            i++;
         }
-
-        prevSoundPort5 = state->memory[0x2098];
-        break;
-        case 6: //Watch-dog.
-        break;
     }
+
+    return SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, 256, 224);
 }
 
 void Render(State8080 *state, SDL_Window *window, SDL_Renderer *renderer, SDL_Texture *Game){
@@ -301,7 +604,28 @@ void Render(State8080 *state, SDL_Window *window, SDL_Renderer *renderer, SDL_Te
     int vRamSize = 0x1c00;
     int i = 0;
     int byte = 0;
-    Uint32 pixels[0x1c00 * 8]; //8 pixels in each byte, so make an array 8 times the size of the vRAM, one index for each bit.
+    int bit;
+    void *pixels;
+    //8 pixels in each byte, so make an array 8 times the size of the vRAM, one index for each bit. Only the one matching the texture format is used.
+    static Uint32 pixels32[0x1c00 * 8];
+    static Uint16 pixels16[0x1c00 * 8];
+    static Uint8 pixels8[0x1c00 * 8];
+    //What was last drawn. If neither the VRAM nor the overlay has changed, the texture and the window already show the right picture, so skip converting, uploading and presenting.
+    static uint64_t lastHash = 0;
+    static int lastOverlay = -1;
+    uint64_t hash = VRAMHash(state->memory);
+
+    if (redrawScreen){
+        lastHash = ~hash;
+        redrawScreen = 0;
+    }
+    if (hash == lastHash && currentOverlay == lastOverlay){
+        stats.unchangedRenders++;
+        return;
+    }
+    lastHash = hash;
+    lastOverlay = currentOverlay;
+    stats.renders++;
 
     //Draw white border around screen. For testing only. Comment out when not in use.
 //        while (i < 224){
@@ -325,31 +649,44 @@ void Render(State8080 *state, SDL_Window *window, SDL_Renderer *renderer, SDL_Te
 //        }
 //        i = 0;
 
-    //Convert each byte into a stream of 8 pixels per byte. Space invaders is 1 bit per pixel, but modern GPUs (as of writing, 2024) need 4 bytes per pixel.
-    while (byte < vRamSize){
-        //Render starting from the least significant bit. Output white if bit is 1, 0 if black. Loop through all 8 bits in each byte.
-        if ((state->memory[memOffset + byte] << (7 - (i % 8))) & 0x80){
-            //Green area, from slightly above the bunkers down to the bottom line. Also the area containing remaining lives.
-            if ((byte % 32 >= 2 && byte % 32 <= 8) || (byte % 32 < 2 && i / 256 >= 25 && i / 256 <= 135)){
-                pixels[i] = 0x0000FF00;
-            }
-            //Red area, from just below the score to above the tip of the highest aliens' heads.
-            else if (byte % 32 >= 24 && byte % 32 <= 27){
-                pixels[i] = 0x000000FF;
-            }
-            //Everything else, white.
-            else{
-                pixels[i] = 0xFFFFFFFF;
+    //Convert each byte into a stream of 8 pixels per byte, in whichever texture format CreateScreenTexture picked. Space invaders is 1 bit per pixel, and the screen only ever shows 4 colours, so a smaller format means less data uploaded every frame.
+    //Render starting from the least significant bit. Each bit becomes a mask of all 1s if lit or all 0s if not, which picks either the overlay colour for that pixel or black. No branches, so the compiler can vectorise the 8 pixels.
+    switch (screenPixelSize){
+        case 1:
+        while (byte < vRamSize){
+            uint8_t value = state->memory[memOffset + byte];
+            for (bit = 0; bit < 8; bit++){
+                pixels8[i + bit] = overlayMask8[i + bit] & (0u - ((value >> bit) & 0x1));
             }
+            i += 8;
+            byte++;
         }
-        else{
-            pixels[i] = 0x00000000; //Black
+        pixels = pixels8;
+        break;
+
+        case 2:
+        while (byte < vRamSize){
+            uint8_t value = state->memory[memOffset + byte];
+            for (bit = 0; bit < 8; bit++){
+                pixels16[i + bit] = overlayMask16[i + bit] & (0u - ((value >> bit) & 0x1));
+            }
+            i += 8;
+            byte++;
         }
-        i++;
-        //Increment byte when final bit is processed.
-        if (i % 8 == 0){
+        pixels = pixels16;
+        break;
+
+        default:
+        while (byte < vRamSize){
+            uint8_t value = state->memory[memOffset + byte];
+            for (bit = 0; bit < 8; bit++){
+                pixels32[i + bit] = overlayMask32[i + bit] & (0u - (Uint32) ((value >> bit) & 0x1));
+            }
+            i += 8;
             byte++;
         }
+        pixels = pixels32;
+        break;
     }
 
     SDL_Rect screen;
@@ -363,7 +700,7 @@ void Render(State8080 *state, SDL_Window *window, SDL_Renderer *renderer, SDL_Te
     corner.y = 512;
 
     SDL_SetRenderTarget(renderer, Game);
-    SDL_UpdateTexture(Game, &screen, pixels, 1024);
+    SDL_UpdateTexture(Game, NULL, pixels, 256 * screenPixelSize);
     SDL_SetRenderTarget(renderer, NULL);
     SDL_RenderCopyEx(renderer, Game, NULL, &screen, -90, &corner, 0);
     SDL_RenderPresent(renderer);
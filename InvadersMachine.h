@@ -1,5 +1,67 @@
 #include <SDL.h>
+#include "Scheduler.h"
+
+//The 8080 runs at 2 MHz and the screen at 60 frames per second. Interrupts are raised halfway down the screen (RST 1) and at the bottom, when VBlank starts (RST 2).
+#define CPU_CLOCK 2000000
+#define FRAME_RATE 60
+
+//Memory is the 64K address space, plus one page past its end that writes to ROM are sent to, so that MemWrite never has to check for them.
+#define DISCARD_PAGE 0x10000
+#define MEMORY_SIZE (0x10000 + 0x100)
+
+//The CPU can be overclocked to this many times the real clock. Frames still last 1/60 of a second.
+#define MAX_CLOCK_MULTIPLIER 8
+
+//Board hardware outside the CPU, one per emulated machine.
+typedef struct InvadersIO{
+    Scheduler   scheduler;      //Interrupts and other timed events.
+    uint64_t    frame;          //Frame currently being drawn.
+    uint64_t    clockFrame;     //First frame run at the current clock multiplier, and the cycle count it started at.
+    uint64_t    clockCycle;
+    uint8_t     clockMultiplier;
+    uint8_t     overran;        //Whether an interrupt has been held up in the current frame.
+    uint64_t    interrupts;     //Interrupts delivered since power on.
+    uint64_t    overruns;       //Frames in which an interrupt was held up because the game hadn't finished with the previous one.
+    uint16_t    shiftRegister;
+    uint8_t     shiftOffset;
+    uint8_t     prevSound[2];   //What each sound port held after the last write, to tell which bits went from 0 to 1.
+    uint8_t     inputEnabled;   //Whether this machine reads the keyboard. Only one machine does when several are running.
+    uint8_t     soundEnabled;   //Whether this machine plays sounds.
+    struct SoundSource *sound;  //Where they go. Needs setting before sound is enabled.
+    uint8_t     latchInput;     //Whether input is only sampled at the start of each frame. Otherwise it's also sampled at the mid-screen interrupt, which is half a frame sooner but depends on when the host got round to handling the key.
+    uint8_t     inputPorts[3];  //What IN reads from ports 0-2. Only changes when the input is sampled.
+    uint8_t     inputHeld[3];   //Port bits of the keys held down right now.
+    uint8_t     inputPressed[3];//Port bits of the keys pressed since the last sample, even if they have been let go of since.
+    uint8_t     padHeld[3];     //Port bits of the controller buttons held down right now.
+} InvadersIO;
+
+#define SNAPSHOT_RAM_SIZE 0x4000     //Enough for every game's RAM: 8K on Space Invaders, 8K plus 8K of colour RAM on the colour boards.
+
+//Everything needed to put a machine back exactly as it was: CPU registers, board hardware and all of the RAM the game can write (see SelectMachine), one block after another. The ROM never changes, so it isn't included.
+typedef struct MachineSnapshot{
+    State8080   cpu;
+    InvadersIO  io;
+    uint8_t     ram[SNAPSHOT_RAM_SIZE];
+} MachineSnapshot;
+
+extern int redrawScreen;
+
+void InitIO(InvadersIO *);
+void SaveSnapshot(State8080 *, MachineSnapshot *);
+void LoadSnapshot(State8080 *, const MachineSnapshot *);
+void SetClockMultiplier(InvadersIO *, int);
+uint64_t FrameStartCycle(InvadersIO *, uint64_t);
+void RunCPU(State8080 *, uint64_t);
+int HandleNextEvent(State8080 *);
+void EmulateFrame(State8080 *);
+void InputKey(InvadersIO *, SDL_Scancode, int);
+void InputController(InvadersIO *, const uint8_t *, const uint8_t *);
+void ReleaseInput(InvadersIO *);
+void LatchInput(InvadersIO *);
 void Interrupt(State8080*, FILE *, int *, int);
 uint8_t ProcessorIN(State8080*, uint8_t);
 void ProcessorOUT(State8080*, uint8_t);
+uint64_t VRAMHash(const uint8_t *);
+uint64_t MachineHash(State8080 *);
+SDL_Texture *CreateScreenTexture(SDL_Renderer *);
 void Render(State8080 *, SDL_Window *, SDL_Renderer *, SDL_Texture *);
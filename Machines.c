@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "Rom.h"
+#include "Machines.h"
+#include "Sound.h"
+#include "Overlay.h"
+
+/*
+The games that run on the Midway 8080 board, or Taito's copies of it. They share the CPU, the interrupts, the shift register and the screen, and differ in their ROMs, where the RAM answers, what the DIP switches are set to and what the sound ports are wired to.
+None of this is looked at while the game runs: SelectMachine turns the description into tables (see InvadersMachine.c) before the first instruction.
+*/
+
+//Space Invaders. Writes to the 8K of RAM at 0x2000 show up again all the way to the top of the address space (reads don't, see WriteRegion).
+static const WriteRegion invadersRegions[] = {
+    {0x2000, 0x3FFF, 0x2000, 0x1FFF},
+    {0x4000, 0xFFFF, 0x2000, 0x1FFF}
+};
+
+//The colour boards (Part II, Lunar Rescue). The RAM is mirrored once, the second 8K of ROM sits at 0x4000, and the colour RAM at 0xC000 is mirrored at 0xE000, for writes only, as on Space Invaders. Colour RAM is kept up to date, but not drawn: the overlays take its place.
+static const WriteRegion colourRegions[] = {
+    {0x2000, 0x3FFF, 0x2000, 0x1FFF},
+    {0x6000, 0x7FFF, 0x2000, 0x1FFF},
+    {0xC000, 0xDFFF, 0xC000, 0x1FFF},
+    {0xE000, 0xFFFF, 0xC000, 0x1FFF}
+};
+
+static const MachineDescription machines[] = {
+    //Port 3 is read from the copy the game keeps at 0x2094 and port 5 from 0x2098. The game sets 0x2098 to 1 before it first writes port 5, so port 5 starts out as 1, or the fleet would play a step at power on.
+    {"invaders", "Space Invaders", &invadersRoms,
+        sizeof(invadersRegions) / sizeof(invadersRegions[0]), invadersRegions,
+        {0x0E, 0x08, 0x0B}, 2, 4, 3,
+        {{3, 0x2094, 0, {SOUND_UFO, SOUND_SHOT, SOUND_PLAYER_DEATH, SOUND_INVADER_DEATH, SOUND_EXTRA_LIFE, -1, -1, -1}, 0x01},
+         {5, 0x2098, 1, {SOUND_FLEET1, SOUND_FLEET2, SOUND_FLEET3, SOUND_FLEET4, SOUND_UFO_HIT, -1, -1, -1}, 0x00}},
+        {0x08, 0x10}, OVERLAY_TAITO},
+
+    //Same sound wiring as Space Invaders.
+    {"invadpt2", "Space Invaders Part II", &invadpt2Roms,
+        sizeof(colourRegions) / sizeof(colourRegions[0]), colourRegions,
+        {0x0E, 0x08, 0x0B}, 2, 4, 3,
+        {{3, 0, 0, {SOUND_UFO, SOUND_SHOT, SOUND_PLAYER_DEATH, SOUND_INVADER_DEATH, SOUND_EXTRA_LIFE, -1, -1, -1}, 0x01},
+         {5, 0, 0, {SOUND_FLEET1, SOUND_FLEET2, SOUND_FLEET3, SOUND_FLEET4, SOUND_UFO_HIT, -1, -1, -1}, 0x00}},
+        {0x08, 0x10}, OVERLAY_MONOCHROME},
+
+    //Lunar Rescue has sounds of its own (thrust, landing, rescue...). Until they are synthesized, each bit plays the Space Invaders sound wired to the same bit, the looping thrust as the UFO.
+    {"lrescue", "Lunar Rescue", &lrescueRoms,
+        sizeof(colourRegions) / sizeof(colourRegions[0]), colourRegions,
+        {0x0E, 0x08, 0x0B}, 2, 4, 3,
+        {{3, 0, 0, {SOUND_UFO, SOUND_SHOT, SOUND_PLAYER_DEATH, SOUND_INVADER_DEATH, SOUND_EXTRA_LIFE, -1, -1, -1}, 0x01},
+         {5, 0, 0, {SOUND_FLEET1, SOUND_FLEET2, SOUND_FLEET3, SOUND_FLEET4, SOUND_UFO_HIT, -1, -1, -1}, 0x00}},
+        {0x08, 0x10}, OVERLAY_MONOCHROME}
+};
+
+#define MACHINE_COUNT (int) (sizeof(machines) / sizeof(machines[0]))
+
+//Returns the machine with the given name, or NULL if there is none.
+const MachineDescription *FindMachine(const char *name){
+    int i = 0;
+
+    while (i < MACHINE_COUNT){
+        if (strcmp(machines[i].name, name) == 0){
+            return &machines[i];
+        }
+        i++;
+    }
+    return NULL;
+}
+
+void PrintMachines(void){
+    int i = 0;
+
+    printf("Games:\n");
+    while (i < MACHINE_COUNT){
+        printf("  %-10s %s\n", machines[i].name, machines[i].title);
+        i++;
+    }
+}
@@ -0,0 +1,39 @@
+//A range of the address space that takes writes. Writes to address go to target + (address & mask). Ranges start and end on 256 byte page boundaries. Writes anywhere else (ROM, or nothing there) are dropped.
+//Only writes are mapped. Reads and opcode fetches go straight to the address, so a mirror (a range whose target isn't its own start) reads as whatever is in memory there, which is zeros, not the RAM it writes to. None of the games here read through a mirror, they only write through one by accident.
+typedef struct WriteRegion{
+    uint16_t    start;
+    uint16_t    end;        //Last address, inclusive.
+    uint16_t    target;
+    uint16_t    mask;
+} WriteRegion;
+
+//An output port that drives the sound boards. Each bit starts a sound when it goes from 0 to 1.
+typedef struct SoundPort{
+    uint8_t     port;
+    uint16_t    shadow;     //RAM address the game keeps a copy of what it wrote in, which is read instead of A. 0 reads A.
+    uint8_t     initial;    //What the port is taken to hold at power on.
+    int8_t      sounds[8];  //Sound started by each bit, or -1 for bits that aren't sounds.
+    uint8_t     stopMask;   //Bits whose sound stops when they go back to 0. Those are the looping sounds.
+} SoundPort;
+
+//Everything that differs between the games on the Midway 8080 board. Ports 0-2 are always the inputs, and the screen is always the 1 bit per pixel bitmap at 0x2400.
+typedef struct MachineDescription{
+    const char          *name;              //Name for -game, the same as MAME's.
+    const char          *title;             //Window title.
+    const struct RomSet *roms;
+    int                 regionCount;
+    const WriteRegion   *regions;
+    uint8_t             idleInput[3];       //What ports 0-2 read with nothing pressed, DIP switches included.
+    uint8_t             shiftAmountPort;    //The bit shift register's ports.
+    uint8_t             shiftDataPort;
+    uint8_t             shiftResultPort;
+    SoundPort           soundPorts[2];
+    uint16_t            vectors[2];         //Where the mid-screen (RST 1) and VBlank (RST 2) interrupts go.
+    int                 overlay;            //Default overlay.
+} MachineDescription;
+
+extern const MachineDescription *machine;
+
+const MachineDescription *FindMachine(const char *);
+void PrintMachines(void);
+void SelectMachine(const MachineDescription *);
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "Mixer.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+The mixer's inner loops. Everything is done in float, four samples at a time with SSE2 where the compiler has it (always on x86-64), and one at a time otherwise. The plain loops give the same results, so builds for other CPUs sound the same.
+*/
+
+#define PI 3.14159265358979323846
+
+//mix += voice * gain.
+void AccumulateMix(float *mix, const float *voice, float gain, int count){
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128 g = _mm_set1_ps(gain);
+    while (i + 4 <= count){
+        _mm_storeu_ps(&mix[i], _mm_add_ps(_mm_loadu_ps(&mix[i]), _mm_mul_ps(_mm_loadu_ps(&voice[i]), g)));
+        i += 4;
+    }
+#endif
+    while (i < count){
+        mix[i] += voice[i] * gain;
+        i++;
+    }
+}
+
+//Scale the mix by the volume and convert it to 16 bit samples, clipping anything that's too loud.
+void ConvertMix(int16_t *out, const float *mix, float volume, int count){
+    float scale = volume * 32767.0f;
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128 s = _mm_set1_ps(scale);
+    __m128 top = _mm_set1_ps(32767.0f);
+    __m128 bottom = _mm_set1_ps(-32768.0f);
+    while (i + 8 <= count){
+        __m128i low = _mm_cvttps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(&mix[i]), s), top), bottom));
+        __m128i high = _mm_cvttps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(&mix[i + 4]), s), top), bottom));
+        _mm_storeu_si128((__m128i *) &out[i], _mm_packs_epi32(low, high));
+        i += 8;
+    }
+#endif
+    while (i < count){
+        float sample = mix[i] * scale;
+        if (sample > 32767.0f){
+            sample = 32767.0f;
+        }
+        if (sample < -32768.0f){
+            sample = -32768.0f;
+        }
+        out[i] = (int16_t) sample;
+        i++;
+    }
+}
+
+//Build the filters for converting from inRate to outRate. When going down in rate, the cutoff comes down with it (with a little room for the filter to roll off), so nothing above the new Nyquist frequency folds back as aliasing.
+void InitResampler(Resampler *resampler, int inRate, int outRate){
+    double cutoff = inRate > outRate ? 0.9 * outRate / inRate : 1.0;
+    int phase = 0;
+
+    resampler->step = (uint64_t) (((double) inRate / outRate) * 4294967296.0);
+
+    while (phase < RESAMPLER_PHASES){
+        double sum = 0.0;
+        int tap = 0;
+
+        while (tap < RESAMPLER_TAPS){
+            //Distance from the output sample to this tap's input sample, and the Blackman window over the whole filter.
+            double x = (tap - (RESAMPLER_TAPS / 2 - 1)) - (double) phase / RESAMPLER_PHASES;
+            double w = (tap + 1.0 - (double) phase / RESAMPLER_PHASES) / RESAMPLER_TAPS;
+            double window = 0.42 - 0.5 * cos(2.0 * PI * w) + 0.08 * cos(4.0 * PI * w);
+            double value = x == 0.0 ? cutoff : sin(PI * cutoff * x) / (PI * x);
+            resampler->filter[phase][tap] = (float) (value * window);
+            sum += value * window;
+            tap++;
+        }
+
+        //Each phase should pass a steady signal through unchanged.
+        tap = 0;
+        while (tap < RESAMPLER_TAPS){
+            resampler->filter[phase][tap] = (float) (resampler->filter[phase][tap] / sum);
+            tap++;
+        }
+        phase++;
+    }
+}
+
+/*
+Resample from data (length samples) into out, starting at *position (32.32 fixed point, in input samples), which is moved on. A looping sound wraps around at the end, otherwise this stops there. Returns how many samples were written.
+data needs RESAMPLER_TAPS samples of padding before its start and after its end (silence, or the other end of the sound if it loops), so the filters never have to check where they are.
+*/
+int Resample(const Resampler *resampler, const float *data, int length, int loop, uint64_t *position, float *out, int count){
+    uint64_t end = (uint64_t) length << 32;
+    uint64_t pos = *position;
+    int i = 0;
+
+    while (i < count){
+        const float *in;
+        const float *filter;
+        float sum;
+        int tap;
+
+        if (pos >= end){
+            if (loop == 0){
+                break;
+            }
+            pos -= end;
+        }
+
+        in = &data[(int) (pos >> 32) - (RESAMPLER_TAPS / 2 - 1)];
+        filter = resampler->filter[(pos >> (32 - RESAMPLER_PHASE_BITS)) & (RESAMPLER_PHASES - 1)];
+
+#if defined(__SSE2__)
+        {
+            __m128 acc = _mm_setzero_ps();
+            float lanes[4];
+            tap = 0;
+            while (tap < RESAMPLER_TAPS){
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&in[tap]), _mm_loadu_ps(&filter[tap])));
+                tap += 4;
+            }
+            _mm_storeu_ps(lanes, acc);
+            sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+#else
+        {
+            float lanes[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            tap = 0;
+            while (tap < RESAMPLER_TAPS){
+                lanes[0] += in[tap] * filter[tap];
+                lanes[1] += in[tap + 1] * filter[tap + 1];
+                lanes[2] += in[tap + 2] * filter[tap + 2];
+                lanes[3] += in[tap + 3] * filter[tap + 3];
+                tap += 4;
+            }
+            sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+#endif
+
+        out[i] = sum;
+        pos += resampler->step;
+        i++;
+    }
+
+    *position = pos;
+    return i;
+}
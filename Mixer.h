@@ -0,0 +1,15 @@
+//Building blocks for mixing: adding voices together with a gain, turning the mix into 16 bit samples, and resampling sounds recorded at other rates.
+#define RESAMPLER_PHASE_BITS 8
+#define RESAMPLER_PHASES (1 << RESAMPLER_PHASE_BITS)   //Fractional positions between input samples that have a filter of their own.
+#define RESAMPLER_TAPS 32       //Input samples each output sample is made from. Must be a multiple of 4.
+
+//Windowed sinc filter bank for converting from one sample rate to another, one filter per phase.
+typedef struct Resampler{
+    float       filter[RESAMPLER_PHASES][RESAMPLER_TAPS];
+    uint64_t    step;           //Input samples per output sample, 32.32 fixed point.
+} Resampler;
+
+void AccumulateMix(float *, const float *, float, int);
+void ConvertMix(int16_t *, const float *, float, int);
+void InitResampler(Resampler *, int, int);
+int Resample(const Resampler *, const float *, int, int, uint64_t *, float *, int);
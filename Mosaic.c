@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "8080Emulator.h"
+#include <SDL.h>
+#include "InvadersMachine.h"
+#include "Overlay.h"
+#include "Mosaic.h"
+#include "Stats.h"
+
+static void ConvertThumbnail(Mosaic *, const uint8_t *);
+
+//Work out the grid layout and allocate buffers. Columns of 0 picks a roughly square grid. Returns 0 on success.
+int CreateMosaic(Mosaic *mosaic, int count, int columns, int scale, int maxHeight){
+    int i = 0;
+
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8){
+        printf("Error: thumbnail scale must be 1, 2, 4 or 8!\n");
+        return 1;
+    }
+
+    if (columns <= 0){
+        columns = 1;
+        while (columns * columns < count){
+            columns++;
+        }
+    }
+
+    mosaic->count = count;
+    mosaic->columns = columns;
+    mosaic->rows = (count + columns - 1) / columns;
+    mosaic->scale = scale;
+    mosaic->thumbWidth = 224 / scale;
+    mosaic->thumbHeight = 256 / scale;
+    mosaic->visibleRows = maxHeight / mosaic->thumbHeight;
+    if (mosaic->visibleRows < 1){
+        mosaic->visibleRows = 1;
+    }
+    if (mosaic->visibleRows > mosaic->rows){
+        mosaic->visibleRows = mosaic->rows;
+    }
+    mosaic->firstRow = 0;
+    mosaic->focus = 0;
+    mosaic->texture = NULL;
+
+    mosaic->pixels = malloc(sizeof(Uint32) * mosaic->thumbWidth * mosaic->thumbHeight);
+    mosaic->lastHash = malloc(sizeof(uint64_t) * count);
+    mosaic->slotOwner = malloc(sizeof(int) * columns * mosaic->visibleRows);
+    mosaic->lastOverlay = -1;
+    if (mosaic->pixels == NULL || mosaic->lastHash == NULL || mosaic->slotOwner == NULL){
+        printf("Error: could not allocate memory for the mosaic!\n");
+        return 1;
+    }
+
+    while (i < columns * mosaic->visibleRows){
+        mosaic->slotOwner[i] = -1;
+        i++;
+    }
+    return 0;
+}
+
+//Create the texture holding one page of thumbnails, and clear it to black. Returns 0 on success.
+int CreateMosaicTexture(Mosaic *mosaic, SDL_Renderer *renderer){
+    int width = mosaic->columns * mosaic->thumbWidth;
+    int height = mosaic->visibleRows * mosaic->thumbHeight;
+    Uint32 *black;
+
+    mosaic->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (mosaic->texture == NULL){
+        printf("Error: could not create mosaic texture: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    //Empty slots (past the last machine) are never written to, so they need to start out black.
+    black = calloc(width * height, sizeof(Uint32));
+    if (black == NULL){
+        printf("Error: could not allocate memory for the mosaic!\n");
+        return 1;
+    }
+    SDL_UpdateTexture(mosaic->texture, NULL, black, width * sizeof(Uint32));
+    free(black);
+    return 0;
+}
+
+void DestroyMosaic(Mosaic *mosaic){
+    if (mosaic->texture != NULL){
+        SDL_DestroyTexture(mosaic->texture);
+    }
+    free(mosaic->pixels);
+    free(mosaic->lastHash);
+    free(mosaic->slotOwner);
+}
+
+//Move the page up (negative) or down (positive) by the given number of pages.
+void ScrollMosaic(Mosaic *mosaic, int pages){
+    int lastRow = mosaic->rows - mosaic->visibleRows;
+
+    mosaic->firstRow += pages * mosaic->visibleRows;
+    if (mosaic->firstRow > lastRow){
+        mosaic->firstRow = lastRow;
+    }
+    if (mosaic->firstRow < 0){
+        mosaic->firstRow = 0;
+    }
+}
+
+//Convert one machine's VRAM straight into a rotated, downsampled thumbnail in mosaic->pixels.
+static void ConvertThumbnail(Mosaic *mosaic, const uint8_t *vram){
+    int scale = mosaic->scale;
+    int x;
+    int y;
+    int k;
+    uint8_t merged[32];
+
+    //Each thumbnail column covers "scale" VRAM rows (a VRAM row is one screen column, bottom to top). OR them together first, so a pixel is lit if any of the pixels it covers is lit. That way thin lines such as shots don't disappear.
+    for (x = 0; x < mosaic->thumbWidth; x++){
+        const uint8_t *row = vram + x * scale * 32;
+        memcpy(merged, row, 32);
+        for (k = 1; k < scale; k++){
+            for (y = 0; y < 32; y++){
+                merged[y] |= row[k * 32 + y];
+            }
+        }
+
+        //Then walk down the screen, which is from the last pixel column of the VRAM row to the first.
+        for (y = 0; y < mosaic->thumbHeight; y++){
+            int column = 255 - y * scale;
+            uint8_t lit = 0;
+            for (k = 0; k < scale; k++){
+                lit |= merged[(column - k) >> 3] >> ((column - k) & 0x7);
+            }
+            lit &= 0x1;
+            mosaic->pixels[y * mosaic->thumbWidth + x] = overlayMask32[x * scale * 256 + column] & (0u - (Uint32) lit);
+        }
+    }
+}
+
+//Update the thumbnails of the machines on the current page and present the window. Machines that are off the page, or whose VRAM hasn't changed since their thumbnail was last converted, are skipped. If no thumbnail changed and the focus didn't move, nothing is presented either.
+void RenderMosaic(Mosaic *mosaic, State8080 **machines, SDL_Renderer *renderer){
+    static int lastFocus = -1;
+    int slot = 0;
+    int slots = mosaic->columns * mosaic->visibleRows;
+    int first = mosaic->firstRow * mosaic->columns;
+    int changed = (mosaic->focus != lastFocus);
+    int overlayChanged = (currentOverlay != mosaic->lastOverlay || redrawScreen);
+    SDL_Rect rect;
+
+    while (slot < slots && first + slot < mosaic->count){
+        int machine = first + slot;
+        uint64_t hash = VRAMHash(machines[machine]->memory);
+
+        if (mosaic->slotOwner[slot] != machine || hash != mosaic->lastHash[machine] || overlayChanged){
+            mosaic->lastHash[machine] = hash;
+            ConvertThumbnail(mosaic, &machines[machine]->memory[0x2400]);
+            changed = 1;
+
+            rect.x = (slot % mosaic->columns) * mosaic->thumbWidth;
+            rect.y = (slot / mosaic->columns) * mosaic->thumbHeight;
+            rect.w = mosaic->thumbWidth;
+            rect.h = mosaic->thumbHeight;
+            SDL_UpdateTexture(mosaic->texture, &rect, mosaic->pixels, mosaic->thumbWidth * sizeof(Uint32));
+            mosaic->slotOwner[slot] = machine;
+        }
+        slot++;
+    }
+
+    //The last page may not be full. Slots past the last machine still hold whatever the previous page had there, so black them out (once).
+    while (slot < slots){
+        if (mosaic->slotOwner[slot] != -1){
+            memset(mosaic->pixels, 0, sizeof(Uint32) * mosaic->thumbWidth * mosaic->thumbHeight);
+            rect.x = (slot % mosaic->columns) * mosaic->thumbWidth;
+            rect.y = (slot / mosaic->columns) * mosaic->thumbHeight;
+            rect.w = mosaic->thumbWidth;
+            rect.h = mosaic->thumbHeight;
+            SDL_UpdateTexture(mosaic->texture, &rect, mosaic->pixels, mosaic->thumbWidth * sizeof(Uint32));
+            mosaic->slotOwner[slot] = -1;
+            changed = 1;
+        }
+        slot++;
+    }
+    mosaic->lastOverlay = currentOverlay;
+    redrawScreen = 0;
+
+    if (changed == 0){
+        stats.unchangedRenders++;
+        return;
+    }
+    lastFocus = mosaic->focus;
+    stats.renders++;
+
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, mosaic->texture, NULL, NULL);
+
+    //Outline the machine that has focus, if it's on this page.
+    if (mosaic->focus >= first && mosaic->focus < first + slots){
+        rect.x = ((mosaic->focus - first) % mosaic->columns) * mosaic->thumbWidth;
+        rect.y = ((mosaic->focus - first) / mosaic->columns) * mosaic->thumbHeight;
+        rect.w = mosaic->thumbWidth;
+        rect.h = mosaic->thumbHeight;
+        SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0x00, 0xFF);
+        SDL_RenderDrawRect(renderer, &rect);
+        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+    }
+
+    SDL_RenderPresent(renderer);
+}
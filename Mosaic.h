@@ -0,0 +1,25 @@
+#include <SDL.h>
+
+//Grid of thumbnails showing many machines in one window. Only the rows that fit in the window are shown at a time (the page), and PageUp/PageDown move between pages.
+typedef struct Mosaic{
+    int             count;          //Number of machines.
+    int             columns;
+    int             rows;           //Rows needed to show every machine.
+    int             visibleRows;    //Rows that fit in the window.
+    int             firstRow;       //Top row of the page currently shown.
+    int             scale;          //Downsampling factor. A thumbnail is (224 / scale) x (256 / scale) pixels.
+    int             thumbWidth;
+    int             thumbHeight;
+    int             focus;          //Machine that gets keyboard input and sound.
+    SDL_Texture     *texture;       //Holds the whole page.
+    Uint32          *pixels;        //Staging buffer for one thumbnail.
+    uint64_t        *lastHash;      //Hash of each machine's VRAM as of its last conversion.
+    int             lastOverlay;    //Overlay the thumbnails were converted with.
+    int             *slotOwner;     //Machine whose thumbnail is currently in each slot of the texture, or -1.
+} Mosaic;
+
+int CreateMosaic(Mosaic *, int, int, int, int);
+int CreateMosaicTexture(Mosaic *, SDL_Renderer *);
+void DestroyMosaic(Mosaic *);
+void ScrollMosaic(Mosaic *, int);
+void RenderMosaic(Mosaic *, State8080 **, SDL_Renderer *);
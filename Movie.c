@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "Movie.h"
+
+/*
+Movie file layout. All numbers are little endian.
+    8 bytes     "INVMOVIE"
+    4 bytes     format version (2)
+    4 bytes     ROM CRC-32
+    4 bytes     clock multiplier
+    8 bytes     start hash
+    8 bytes     frame count
+    8 bytes     end hash
+Then the input, run length encoded: one byte with the number of frames in the run (1-255), then the port 1 and port 2 bytes for those frames. Players mostly hold keys for many frames at a time, so runs are long.
+The frame count and end hash are only known once recording stops, so the header is written twice.
+*/
+
+#define MOVIE_VERSION 2     //2: MachineHash covers the board as well as the RAM and CPU, so older hashes can't match.
+#define MOVIE_HEADER_SIZE 44
+#define MAX_RUN 255
+
+static void PutNumber(uint8_t *buffer, uint64_t value, int bytes){
+    int i = 0;
+
+    while (i < bytes){
+        buffer[i] = (value >> (i * 8)) & 0xFF;
+        i++;
+    }
+}
+
+static uint64_t GetNumber(const uint8_t *buffer, int bytes){
+    uint64_t value = 0;
+
+    while (bytes > 0){
+        bytes--;
+        value = (value << 8) | buffer[bytes];
+    }
+    return value;
+}
+
+static int WriteHeader(Movie *movie){
+    uint8_t buffer[MOVIE_HEADER_SIZE];
+
+    memcpy(buffer, "INVMOVIE", 8);
+    PutNumber(&buffer[8], MOVIE_VERSION, 4);
+    PutNumber(&buffer[12], movie->header.romCrc, 4);
+    PutNumber(&buffer[16], movie->header.clockMultiplier, 4);
+    PutNumber(&buffer[20], movie->header.startHash, 8);
+    PutNumber(&buffer[28], movie->header.frames, 8);
+    PutNumber(&buffer[36], movie->header.endHash, 8);
+
+    if (fseek(movie->file, 0, SEEK_SET) != 0 || fwrite(buffer, 1, MOVIE_HEADER_SIZE, movie->file) != MOVIE_HEADER_SIZE){
+        return 1;
+    }
+    return 0;
+}
+
+static int WriteRun(Movie *movie){
+    uint8_t record[3] = {movie->run, movie->port1, movie->port2};
+
+    if (movie->run == 0){
+        return 0;
+    }
+    movie->run = 0;
+    return fwrite(record, 1, 3, movie->file) != 3;
+}
+
+//Create the movie file. The frame count and end hash in the header are filled in by FinishRecording. Returns 0 on success.
+int StartRecording(Movie *movie, const char *path, const MovieHeader *header){
+    movie->file = fopen(path, "wb");
+    if (movie->file == NULL){
+        printf("Error: could not create movie file %s!\n", path);
+        return 1;
+    }
+
+    movie->header = *header;
+    movie->header.frames = 0;
+    movie->header.endHash = 0;
+    movie->frame = 0;
+    movie->run = 0;
+    if (WriteHeader(movie) != 0){
+        printf("Error: could not write movie file %s!\n", path);
+        fclose(movie->file);
+        return 1;
+    }
+    return 0;
+}
+
+//Add one frame's input. Identical frames are only counted until the run ends.
+void RecordFrame(Movie *movie, uint8_t port1, uint8_t port2){
+    if (movie->run > 0 && (port1 != movie->port1 || port2 != movie->port2 || movie->run == MAX_RUN)){
+        WriteRun(movie);
+    }
+    movie->port1 = port1;
+    movie->port2 = port2;
+    movie->run++;
+    movie->frame++;
+}
+
+//Write out the last run and the completed header, and close the file. Returns 0 on success.
+int FinishRecording(Movie *movie, uint64_t endHash){
+    int error = WriteRun(movie);
+
+    movie->header.frames = movie->frame;
+    movie->header.endHash = endHash;
+    error |= WriteHeader(movie);
+    error |= (fclose(movie->file) != 0);
+    if (error){
+        printf("Error: could not write movie file!\n");
+    }
+    return error;
+}
+
+//Open a movie and read its header into movie->header. Returns 0 on success.
+int StartPlayback(Movie *movie, const char *path){
+    uint8_t buffer[MOVIE_HEADER_SIZE];
+
+    movie->file = fopen(path, "rb");
+    if (movie->file == NULL){
+        printf("Error: could not open movie file %s!\n", path);
+        return 1;
+    }
+
+    if (fread(buffer, 1, MOVIE_HEADER_SIZE, movie->file) != MOVIE_HEADER_SIZE || memcmp(buffer, "INVMOVIE", 8) != 0 || GetNumber(&buffer[8], 4) != MOVIE_VERSION){
+        printf("Error: %s is not a movie file, or is from a different version!\n", path);
+        fclose(movie->file);
+        return 1;
+    }
+
+    movie->header.romCrc = GetNumber(&buffer[12], 4);
+    movie->header.clockMultiplier = GetNumber(&buffer[16], 4);
+    movie->header.startHash = GetNumber(&buffer[20], 8);
+    movie->header.frames = GetNumber(&buffer[28], 8);
+    movie->header.endHash = GetNumber(&buffer[36], 8);
+    movie->frame = 0;
+    movie->run = 0;
+    return 0;
+}
+
+//Get the next frame's input. Returns 0 once the movie has run out, leaving the ports alone.
+int PlayFrame(Movie *movie, uint8_t *port1, uint8_t *port2){
+    if (movie->frame >= movie->header.frames){
+        return 0;
+    }
+
+    if (movie->run == 0){
+        uint8_t record[3];
+        if (fread(record, 1, 3, movie->file) != 3 || record[0] == 0){
+            printf("Error: movie file ends early, at frame %llu!\n", (unsigned long long) movie->frame);
+            movie->header.frames = movie->frame;
+            return 0;
+        }
+        movie->run = record[0];
+        movie->port1 = record[1];
+        movie->port2 = record[2];
+    }
+
+    *port1 = movie->port1;
+    *port2 = movie->port2;
+    movie->run--;
+    movie->frame++;
+    return 1;
+}
+
+void StopPlayback(Movie *movie){
+    fclose(movie->file);
+}
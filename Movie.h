@@ -0,0 +1,24 @@
+//Recorded input, so a session can be played back exactly. Needs deterministic mode, which samples input once per frame: a movie is the port 1 and 2 bytes for every frame.
+typedef struct MovieHeader{
+    uint32_t    romCrc;             //CRC-32 of the ROM it was recorded with.
+    uint32_t    clockMultiplier;    //Overclocking changes how the game runs, so it has to match too.
+    uint64_t    startHash;          //MachineHash of the machine when recording started (always power on, for now).
+    uint64_t    frames;             //Frames recorded.
+    uint64_t    endHash;            //MachineHash after the last frame, to check that playback ended up in the same place.
+} MovieHeader;
+
+typedef struct Movie{
+    FILE        *file;
+    MovieHeader header;
+    uint64_t    frame;      //Frames recorded or played so far.
+    uint8_t     port1;      //Input of the current run of identical frames, and how long the run is (recording) or how much of it is left (playback).
+    uint8_t     port2;
+    int         run;
+} Movie;
+
+int StartRecording(Movie *, const char *, const MovieHeader *);
+void RecordFrame(Movie *, uint8_t, uint8_t);
+int FinishRecording(Movie *, uint64_t);
+int StartPlayback(Movie *, const char *);
+int PlayFrame(Movie *, uint8_t *, uint8_t *);
+void StopPlayback(Movie *);
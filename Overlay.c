@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "Overlay.h"
+
+/*
+The screen is rotated, so a VRAM row (32 bytes, 256 pixels) is one column of the screen as seen by the player, starting at the bottom.
+Pixel column 0-255 within a row therefore goes from the bottom of the screen to the top, and row 0-223 goes from left to right.
+Regions are applied in order, so later regions are drawn on top of earlier ones. Anything not covered by a region is white.
+*/
+
+//Original Taito cellophane. Green from slightly above the bunkers down to the bottom line, plus the area containing remaining lives. Red from just below the score to above the tip of the highest aliens' heads.
+static const OverlayRegion taitoRegions[] = {
+    {OVERLAY_GREEN, 16, 71, 0, 223},
+    {OVERLAY_GREEN, 0, 15, 25, 135},
+    {OVERLAY_RED, 192, 223, 0, 223}
+};
+
+//Midway upright. The green strip covers the whole bottom of the screen (including the credit count), and the red strip is slightly wider.
+static const OverlayRegion midwayRegions[] = {
+    {OVERLAY_GREEN, 0, 71, 0, 223},
+    {OVERLAY_RED, 184, 223, 0, 223}
+};
+
+static const Overlay overlays[OVERLAY_COUNT] = {
+    {"taito", sizeof(taitoRegions) / sizeof(taitoRegions[0]), taitoRegions},
+    {"midway", sizeof(midwayRegions) / sizeof(midwayRegions[0]), midwayRegions},
+    {"mono", 0, NULL}
+};
+
+//Colour of each overlay colour index in each of the texture formats the screen can be uploaded in (RGBA32, RGB565 and RGB332). All four colours are exact in every format.
+static const Uint32 overlayPalette32[OVERLAY_COLOURS] = {0x00000000, 0xFFFFFFFF, 0x000000FF, 0x0000FF00};
+static const Uint16 overlayPalette16[OVERLAY_COLOURS] = {0x0000, 0xFFFF, 0xF800, 0x07E0};
+static const Uint8 overlayPalette8[OVERLAY_COLOURS] = {0x00, 0xFF, 0xE0, 0x1C};
+
+//Colour of every pixel on the screen if it were lit, one entry per pixel in VRAM order. Rendering ANDs a lit/unlit mask with this, so there is no per-pixel branching.
+Uint32 overlayMask32[0x1c00 * 8];
+Uint16 overlayMask16[0x1c00 * 8];
+Uint8 overlayMask8[0x1c00 * 8];
+uint8_t overlayColour[0x1c00 * 8];  //Colour index rather than colour, for renderers that don't use pixels.
+int currentOverlay = OVERLAY_TAITO;
+
+static void SetOverlayPixel(int pixel, uint8_t colour){
+    overlayMask32[pixel] = overlayPalette32[colour];
+    overlayMask16[pixel] = overlayPalette16[colour];
+    overlayMask8[pixel] = overlayPalette8[colour];
+    overlayColour[pixel] = colour;
+}
+
+void SelectOverlay(int number){
+    const Overlay *overlay;
+    int region = 0;
+    int row;
+    int column;
+
+    if (number < 0 || number >= OVERLAY_COUNT){
+        printf("Error: invalid overlay!\n");
+        return;
+    }
+    overlay = &overlays[number];
+
+    //Start with everything white, then paint each strip of cellophane on top.
+    for (row = 0; row < 224; row++){
+        for (column = 0; column < 256; column++){
+            SetOverlayPixel(row * 256 + column, OVERLAY_WHITE);
+        }
+    }
+
+    while (region < overlay->regionCount){
+        const OverlayRegion *r = &overlay->regions[region];
+        for (row = r->rowStart; row <= r->rowEnd; row++){
+            for (column = r->columnStart; column <= r->columnEnd; column++){
+                SetOverlayPixel(row * 256 + column, r->colour);
+            }
+        }
+        region++;
+    }
+
+    currentOverlay = number;
+}
+
+//Returns the overlay number matching the given name, or -1 if there is none.
+int FindOverlay(const char *name){
+    int i = 0;
+
+    while (i < OVERLAY_COUNT){
+        if (strcmp(overlays[i].name, name) == 0){
+            return i;
+        }
+        i++;
+    }
+    return -1;
+}
+
+const char *OverlayName(int number){
+    return overlays[number].name;
+}
@@ -0,0 +1,32 @@
+#include <SDL.h>
+
+//Colour indices used by the overlays. Index 0 is what an unlit pixel shows, no matter the overlay.
+enum {OVERLAY_BLACK, OVERLAY_WHITE, OVERLAY_RED, OVERLAY_GREEN, OVERLAY_COLOURS};
+
+//Overlays that can be selected at runtime.
+enum {OVERLAY_TAITO, OVERLAY_MIDWAY, OVERLAY_MONOCHROME, OVERLAY_COUNT};
+
+//One strip of coloured cellophane. Columns are pixel columns within a VRAM row (0-255, bottom to top of the screen), rows are VRAM rows (0-223, left to right of the screen).
+typedef struct OverlayRegion{
+    uint8_t     colour;
+    int         columnStart;
+    int         columnEnd;
+    int         rowStart;
+    int         rowEnd;
+} OverlayRegion;
+
+typedef struct Overlay{
+    const char              *name;
+    int                     regionCount;
+    const OverlayRegion     *regions;
+} Overlay;
+
+extern Uint32 overlayMask32[];
+extern Uint16 overlayMask16[];
+extern Uint8 overlayMask8[];
+extern uint8_t overlayColour[];
+extern int currentOverlay;
+
+void SelectOverlay(int);
+int FindOverlay(const char *);
+const char *OverlayName(int);
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "Rom.h"
+#include "Checksum.h"
+#include "Bundle.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define HAVE_MMAP
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define HAVE_MAPVIEW
+#endif
+
+/*
+ROM loading. Every file in a set has to be there, be the right size and match its checksums, otherwise nothing runs: a bad dump tends to crash the game somewhere in the middle rather than straight away, which is much harder to make sense of.
+Files are memory mapped where the OS can do that, so they're checked straight from the page cache and copied once, into the machine's address space, where the CPU reads them from.
+*/
+
+static const RomFile invadersFiles[] = {
+    {"invaders.h", 0x0000, 0x0800, 0x734F5AD8, "ff6200af4c9110d8181249cbcef1a8a40fa40b7f"},
+    {"invaders.g", 0x0800, 0x0800, 0x6BFACA4A, "16f48649b531bdef8c2d1446c429b5f414524350"},
+    {"invaders.f", 0x1000, 0x0800, 0x0CCEAD96, "537aef03468f63c5b9e11dd61e253f7ae17d9743"},
+    {"invaders.e", 0x1800, 0x0800, 0x14E538B0, "1d6ca0c99f9df71e2990b610deb9d7da0125e2d8"}
+};
+
+const RomSet invadersRoms = {"invaders", sizeof(invadersFiles) / sizeof(invadersFiles[0]), invadersFiles};
+
+//The colour boards have a second bank of ROM at 0x4000. The checksums of these sets haven't been recorded here yet, so only their sizes are checked, and loading them says so.
+static const RomFile invadpt2Files[] = {
+    {"pv01", 0x0000, 0x0800, 0, NULL},
+    {"pv02", 0x0800, 0x0800, 0, NULL},
+    {"pv03", 0x1000, 0x0800, 0, NULL},
+    {"pv04", 0x1800, 0x0800, 0, NULL},
+    {"pv05", 0x4000, 0x0800, 0, NULL}
+};
+
+const RomSet invadpt2Roms = {"invadpt2", sizeof(invadpt2Files) / sizeof(invadpt2Files[0]), invadpt2Files};
+
+static const RomFile lrescueFiles[] = {
+    {"lrescue.1", 0x0000, 0x0800, 0, NULL},
+    {"lrescue.2", 0x0800, 0x0800, 0, NULL},
+    {"lrescue.3", 0x1000, 0x0800, 0, NULL},
+    {"lrescue.4", 0x1800, 0x0800, 0, NULL},
+    {"lrescue.5", 0x4000, 0x0800, 0, NULL},
+    {"lrescue.6", 0x4800, 0x0800, 0, NULL}
+};
+
+const RomSet lrescueRoms = {"lrescue", sizeof(lrescueFiles) / sizeof(lrescueFiles[0]), lrescueFiles};
+
+//Map (or failing that, read) the whole file. Returns 0 on success, 1 if it can't be opened, 2 if it can't be read.
+int MapFile(const char *path, MappedFile *file){
+#ifdef HAVE_MMAP
+    struct stat info;
+    void *data;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0){
+        return 1;
+    }
+    if (fstat(fd, &info) != 0){
+        close(fd);
+        return 2;
+    }
+    file->size = (size_t) info.st_size;
+    file->mapped = 1;
+    if (file->size == 0){
+        file->data = NULL;
+        close(fd);
+        return 0;
+    }
+    data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED){
+        return 2;
+    }
+    file->data = data;
+    return 0;
+#elif defined(HAVE_MAPVIEW)
+    LARGE_INTEGER size;
+    HANDLE mapping;
+    void *data;
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (handle == INVALID_HANDLE_VALUE){
+        return 1;
+    }
+    if (!GetFileSizeEx(handle, &size)){
+        CloseHandle(handle);
+        return 2;
+    }
+    file->size = (size_t) size.QuadPart;
+    file->mapped = 1;
+
+    //Empty files can't be mapped on Windows.
+    if (file->size == 0){
+        file->data = NULL;
+        CloseHandle(handle);
+        return 0;
+    }
+
+    //The view keeps the mapping and the file open, so neither handle is needed once it's made.
+    mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL){
+        return 2;
+    }
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL){
+        return 2;
+    }
+    file->data = data;
+    return 0;
+#else
+    //Binary mode, otherwise 0x1A would be taken as the end of the file on Windows.
+    FILE *f = fopen(path, "rb");
+    uint8_t *data;
+    long size;
+
+    if (f == NULL){
+        return 1;
+    }
+    if (fseek(f, 0L, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0L, SEEK_SET) != 0){
+        fclose(f);
+        return 2;
+    }
+    data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, f) != (size_t) size){
+        free(data);
+        fclose(f);
+        return 2;
+    }
+    fclose(f);
+    file->data = data;
+    file->size = (size_t) size;
+    file->mapped = 0;
+    return 0;
+#endif
+}
+
+void UnmapFile(MappedFile *file){
+#if defined(HAVE_MMAP)
+    if (file->mapped == 1 && file->data != NULL){
+        munmap((void *) file->data, file->size);
+    }
+#elif defined(HAVE_MAPVIEW)
+    if (file->mapped == 1 && file->data != NULL){
+        UnmapViewOfFile(file->data);
+    }
+#endif
+    if (file->mapped == 0){
+        free((void *) file->data);
+    }
+    file->data = NULL;
+}
+
+//Open a ROM file in the given directory. The files are named in lower case, as in MAME's sets, but the Windows releases had them capitalised, so that's tried too for case sensitive file systems.
+static int OpenRomFile(const char *directory, const char *name, MappedFile *file, char *path, size_t pathSize){
+    int result;
+
+    snprintf(path, pathSize, "%s/%s", directory, name);
+    result = MapFile(path, file);
+    if (result == 1){
+        size_t nameStart = strlen(path) - strlen(name);
+        path[nameStart] = (char) toupper((unsigned char) path[nameStart]);
+        result = MapFile(path, file);
+        if (result == 1){
+            path[nameStart] = name[0];
+        }
+    }
+    return result;
+}
+
+static void FormatSha1(const uint8_t digest[20], char text[41]){
+    int i = 0;
+
+    while (i < 20){
+        snprintf(&text[i * 2], 3, "%02x", digest[i]);
+        i++;
+    }
+}
+
+/*
+Load every file of a ROM set from the directory into memory, at its address. Files in the asset bundle, if one is open, are taken from there instead. With check set, each file's CRC-32 and SHA-1 have to match the set's, where it has them. Stops at the first problem, saying what it was.
+Returns the address just past the highest ROM (where the RAM starts), or 0 if the set couldn't be loaded.
+*/
+int LoadRomSet(const RomSet *set, const char *directory, uint8_t *memory, int check){
+    char path[1024];
+    int end = 0;
+    int unverified = 0;
+    int i = 0;
+
+    while (i < set->fileCount){
+        const RomFile *rom = &set->files[i];
+        MappedFile file;
+        const BundleEntry *entry;
+        const uint8_t *asset = FindAsset(rom->name, BUNDLE_ROM, &entry);
+        int result = 0;
+
+        if (asset != NULL){
+            file.data = asset;
+            file.size = (size_t) entry->size;
+            file.mapped = 2;
+            snprintf(path, sizeof(path), "%s (from the bundle)", rom->name);
+        }
+        else{
+            result = OpenRomFile(directory, rom->name, &file, path, sizeof(path));
+        }
+
+        if (result == 1){
+            printf("Error: ROM file %s not found! The %s ROM set needs %d files in %s.\n", path, set->name, set->fileCount, directory);
+            return 0;
+        }
+        if (result != 0){
+            printf("Error: could not read ROM file %s!\n", path);
+            return 0;
+        }
+        if (file.size != rom->size){
+            printf("Error: ROM file %s is %lu bytes, it should be %u!\n", path, (unsigned long) file.size, rom->size);
+            UnmapFile(&file);
+            return 0;
+        }
+
+        unverified += (rom->sha1 == NULL);
+        if (check && rom->sha1 != NULL){
+            uint32_t crc = Crc32(file.data, file.size);
+            uint8_t digest[20];
+            char sha1[41];
+
+            Sha1(file.data, file.size, digest);
+            FormatSha1(digest, sha1);
+            if (crc != rom->crc || strcmp(sha1, rom->sha1) != 0){
+                printf("Error: ROM file %s is not a good dump (CRC32 %08x SHA1 %s, expected CRC32 %08x SHA1 %s)! Use -nocheck to load it anyway.\n", path, crc, sha1, rom->crc, rom->sha1);
+                UnmapFile(&file);
+                return 0;
+            }
+        }
+
+        memcpy(memory + rom->address, file.data, file.size);
+        UnmapFile(&file);
+        if (rom->address + rom->size > end){
+            end = rom->address + rom->size;
+        }
+        i++;
+    }
+    if (check && unverified > 0){
+        printf("Warning: %d of the %s ROM files were not verified, since there are no checksums of a good dump to compare them with. Only their sizes were checked.\n", unverified, set->name);
+    }
+    return end;
+}
+
+//CRC-32 of a loaded ROM set, taken over its files in the order they're listed (which is address order). For Space Invaders, whose ROMs fill 0x0000 - 0x1FFF without gaps, that's the same as the CRC of the whole 8K.
+uint32_t RomSetCrc(const RomSet *set, const uint8_t *memory){
+    uint32_t crc = 0;
+    int i = 0;
+
+    while (i < set->fileCount){
+        crc = Crc32Update(crc, memory + set->files[i].address, set->files[i].size);
+        i++;
+    }
+    return crc;
+}
@@ -0,0 +1,30 @@
+//One ROM chip's image: the file it's dumped to, where it goes in the address space, and the checksums of a good dump, as listed by MAME.
+typedef struct RomFile{
+    const char  *name;
+    uint16_t    address;
+    uint16_t    size;
+    uint32_t    crc;
+    const char  *sha1;      //40 hex digits. NULL if there's no known good dump to check against.
+} RomFile;
+
+//A file's contents, mapped or read into memory.
+typedef struct MappedFile{
+    const uint8_t   *data;
+    size_t          size;
+    int             mapped;     //1 if data is a mapping, 0 if it's a malloc'd copy, 2 if it belongs to something else (the asset bundle) and mustn't be freed.
+} MappedFile;
+
+typedef struct RomSet{
+    const char      *name;
+    int             fileCount;
+    const RomFile   *files;
+} RomSet;
+
+extern const RomSet invadersRoms;
+extern const RomSet invadpt2Roms;
+extern const RomSet lrescueRoms;
+
+int LoadRomSet(const RomSet *, const char *, uint8_t *, int);
+uint32_t RomSetCrc(const RomSet *, const uint8_t *);
+int MapFile(const char *, MappedFile *);
+void UnmapFile(MappedFile *);
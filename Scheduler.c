@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "Scheduler.h"
+
+void InitScheduler(Scheduler *scheduler){
+    scheduler->count = 0;
+}
+
+//Add an event. Events due at the same time are handled in the order they were scheduled.
+void ScheduleEvent(Scheduler *scheduler, uint64_t time, int type){
+    int i = scheduler->count;
+
+    if (scheduler->count == MAX_EVENTS){
+        printf("Error: too many scheduled events!\n");
+        return;
+    }
+
+    //Shift later events up by one to make room.
+    while (i > 0 && scheduler->events[i - 1].time > time){
+        scheduler->events[i] = scheduler->events[i - 1];
+        i--;
+    }
+    scheduler->events[i].time = time;
+    scheduler->events[i].type = type;
+    scheduler->count++;
+}
+
+//Remove every pending event of the given type.
+void CancelEvent(Scheduler *scheduler, int type){
+    int from = 0;
+    int to = 0;
+
+    while (from < scheduler->count){
+        if (scheduler->events[from].type != type){
+            scheduler->events[to] = scheduler->events[from];
+            to++;
+        }
+        from++;
+    }
+    scheduler->count = to;
+}
+
+//Cycle count at which the CPU has to stop, because the earliest event is due.
+uint64_t NextEventTime(Scheduler *scheduler){
+    if (scheduler->count == 0){
+        return UINT64_MAX;
+    }
+    return scheduler->events[0].time;
+}
+
+//Remove and return the earliest event.
+ScheduledEvent PopEvent(Scheduler *scheduler){
+    ScheduledEvent event = {UINT64_MAX, EVENT_NONE};
+
+    if (scheduler->count > 0){
+        event = scheduler->events[0];
+        scheduler->count--;
+        memmove(&scheduler->events[0], &scheduler->events[1], sizeof(ScheduledEvent) * scheduler->count);
+    }
+    return event;
+}
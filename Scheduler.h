@@ -0,0 +1,21 @@
+//Things that happen at a given point in emulated time, measured in CPU cycles since power on.
+enum {EVENT_NONE, EVENT_MIDSCREEN, EVENT_VBLANK, EVENT_TYPES};
+
+#define MAX_EVENTS 16
+
+typedef struct ScheduledEvent{
+    uint64_t    time;       //Absolute cycle count the event is due at.
+    int         type;
+} ScheduledEvent;
+
+//Pending events, kept sorted with the earliest first. There are only ever a handful, so a sorted array beats anything fancier.
+typedef struct Scheduler{
+    int                 count;
+    ScheduledEvent      events[MAX_EVENTS];
+} Scheduler;
+
+void InitScheduler(Scheduler *);
+void ScheduleEvent(Scheduler *, uint64_t, int);
+void CancelEvent(Scheduler *, int);
+uint64_t NextEventTime(Scheduler *);
+ScheduledEvent PopEvent(Scheduler *);
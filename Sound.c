@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "Sound.h"
+#include "Audio.h"
+#include "Mixer.h"
+#include "Wav.h"
+#include "Bundle.h"
+
+/*
+Sound playback. The audio device is opened (and the samples decoded, if they're used) once, at startup, so nothing is loaded or allocated while the game is running.
+Each sound has a voice of its own, like each sound circuit on the real board, so retriggering a sound restarts it rather than piling copies on top of each other.
+The machine only queues which sounds to start or stop, along with the cycle count it happened at. Once per interrupt, UpdateSound mixes the emulated time since the last update and queues it for the audio device, starting and stopping the voices at the sample matching each event's cycle. Emulation runs in bursts, so going by when the OUT was executed would make sounds start up to a frame early or late; this way the fleet's rhythm stays steady whatever the host is doing.
+Every machine has a SoundSource of its own, and any number of them can be mixed into the one stream, each voice with its own gain. Samples play at the rate they were recorded at, through a resampler, rather than being converted when they're loaded.
+*/
+
+#define MASTER_VOLUME 0.3f
+#define MAX_RATE_ADJUST 0.005   //Most the number of samples mixed per cycle is stretched or squeezed to keep the audio queue at its target.
+
+//A decoded WAV file, kept at its own rate and converted to the device's as it plays. The samples are floats, with RESAMPLER_TAPS samples of padding either side for the resampler.
+typedef struct BankSample{
+    float       *buffer;        //NULL if the sound is used from the asset bundle.
+    float       *data;          //First sample, inside buffer or the bundle. Only written to while loading a WAV.
+    int         length;
+    Resampler   *resampler;
+} BankSample;
+
+static int soundMode = SOUND_OFF;
+static BankSample bank[SOUND_COUNT];    //Shared by every machine.
+static float soundGains[SOUND_COUNT] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+static float masterVolume = 1.0f;
+
+//The fraction of a sample left over after the last update (in cycles times the sample rate, times 1024 for the rate control below), so rounding errors don't add up.
+static uint64_t leftover = 0;
+
+//Sound goes to this file instead of the audio device when it's open.
+static WavFile wav = {NULL, 0, 0};
+
+//Load one WAV, convert it to mono floats at its own rate, and build the filters to take it to the device's rate. The UFO sound loops, so its padding comes from the other end of the sound rather than being silence. Returns 0 on success.
+static int LoadSample(BankSample *sample, const char *path, int loop){
+    SDL_AudioSpec spec;
+    SDL_AudioCVT convert;
+    Uint8 *data;
+    Uint32 length;
+    int16_t *pcm;
+    int i = 0;
+
+    if (SDL_LoadWAV(path, &spec, &data, &length) == NULL){
+        return 1;
+    }
+    if (SDL_BuildAudioCVT(&convert, spec.format, spec.channels, spec.freq, AUDIO_S16SYS, 1, spec.freq) < 0){
+        SDL_FreeWAV(data);
+        return 1;
+    }
+
+    convert.len = (int) length;
+    convert.buf = malloc(length * convert.len_mult);
+    if (convert.buf == NULL){
+        SDL_FreeWAV(data);
+        return 1;
+    }
+    memcpy(convert.buf, data, length);
+    SDL_FreeWAV(data);
+    if (convert.needed && SDL_ConvertAudio(&convert) != 0){
+        free(convert.buf);
+        return 1;
+    }
+    pcm = (int16_t *) convert.buf;
+
+    sample->length = convert.len_cvt / (int) sizeof(int16_t);
+    sample->buffer = calloc(sample->length + 2 * RESAMPLER_TAPS, sizeof(float));
+    sample->resampler = malloc(sizeof(Resampler));
+    if (sample->length == 0 || sample->buffer == NULL || sample->resampler == NULL){
+        free(convert.buf);
+        free(sample->buffer);
+        free(sample->resampler);
+        sample->buffer = NULL;
+        sample->resampler = NULL;
+        return 1;
+    }
+    sample->data = sample->buffer + RESAMPLER_TAPS;
+    while (i < sample->length){
+        sample->data[i] = pcm[i] * (1.0f / 32768.0f);
+        i++;
+    }
+    free(convert.buf);
+
+    i = 0;
+    while (loop && i < RESAMPLER_TAPS){
+        sample->data[-1 - i] = sample->data[sample->length - 1 - i % sample->length];
+        sample->data[sample->length + i] = sample->data[i % sample->length];
+        i++;
+    }
+
+    InitResampler(sample->resampler, spec.freq, audioRate);
+    return 0;
+}
+
+//Use a sound from the asset bundle where it's mapped, since it was decoded and padded when the bundle was made. Only the resampler's filters are built. Returns 0 on success, 1 if it isn't in the bundle (or there's no bundle).
+static int BundledSample(BankSample *sample, const char *name){
+    const BundleEntry *entry;
+    const uint8_t *asset = FindAsset(name, BUNDLE_SOUND, &entry);
+
+    //A bundle made for a resampler with a different number of taps has the wrong padding. Those sounds are loaded from the WAV files instead.
+    if (asset == NULL || entry->padding != RESAMPLER_TAPS || entry->rate == 0 || entry->size / sizeof(float) <= 2 * RESAMPLER_TAPS){
+        return 1;
+    }
+    sample->resampler = malloc(sizeof(Resampler));
+    if (sample->resampler == NULL){
+        return 1;
+    }
+    sample->buffer = NULL;
+    sample->data = (float *) asset + RESAMPLER_TAPS;
+    sample->length = (int) (entry->size / sizeof(float)) - 2 * RESAMPLER_TAPS;
+    InitResampler(sample->resampler, (int) entry->rate, audioRate);
+    return 0;
+}
+
+//Open the audio device, or the WAV file to write to instead if a path is given, and load the sample files if they're to be used. Returns 0 on success. Missing sample files are only reported, since they're optional.
+int InitSound(int mode, const char *wavPath){
+    char name[16];
+    char path[32];
+    int missing = 0;
+    int i = 0;
+
+    soundMode = SOUND_OFF;
+    if (mode == SOUND_OFF){
+        return 0;
+    }
+    if (wavPath != NULL){
+        audioRate = 48000;
+        if (OpenWav(&wav, wavPath, audioRate) != 0){
+            return 1;
+        }
+    }
+    else if (OpenAudio(48000) != 0){
+        return 1;
+    }
+
+    //Sounds in the asset bundle are used from it, the rest are loaded from the Sounds folder.
+    if (mode == SOUND_SAMPLES){
+        while (i < SOUND_COUNT){
+            snprintf(name, sizeof(name), "%d.wav", i);
+            snprintf(path, sizeof(path), "Sounds/%s", name);
+            if (BundledSample(&bank[i], name) != 0 && LoadSample(&bank[i], path, i == SOUND_UFO) != 0){
+                missing++;
+            }
+            i++;
+        }
+        if (missing == SOUND_COUNT){
+            printf("No sound files found in Sounds/, running without sound.\n");
+        }
+        else if (missing > 0){
+            printf("%d of the sound files in Sounds/ are missing, those sounds won't play.\n", missing);
+        }
+    }
+
+    soundMode = mode;
+    return 0;
+}
+
+//Returns 0 on success, 1 if the WAV file couldn't be finished.
+int CloseSound(void){
+    int result = 0;
+    int i = 0;
+
+    if (soundMode == SOUND_OFF){
+        return 0;
+    }
+    if (wav.file != NULL){
+        if (CloseWav(&wav) != 0){
+            printf("Error: could not finish writing the WAV file!\n");
+            result = 1;
+        }
+    }
+    else{
+        CloseAudio();
+    }
+    while (i < SOUND_COUNT){
+        free(bank[i].buffer);
+        free(bank[i].resampler);
+        bank[i].buffer = NULL;
+        bank[i].data = NULL;
+        bank[i].resampler = NULL;
+        i++;
+    }
+    soundMode = SOUND_OFF;
+    return result;
+}
+
+//Volume of everything, 1 being normal.
+void SetMasterVolume(float volume){
+    masterVolume = volume;
+}
+
+//Volume of one sound on every machine, 1 being normal.
+void SetSoundGain(int sound, float gain){
+    if (sound >= 0 && sound < SOUND_COUNT){
+        soundGains[sound] = gain;
+    }
+}
+
+void InitSoundSource(SoundSource *source){
+    memset(source, 0, sizeof(SoundSource));
+    source->gain = 1.0f;
+}
+
+//Queue sounds (a bit per sound number) to be started and stopped at the given cycle. Cheap enough to call from the middle of an OUT instruction. If the queue is somehow full, the event is merged into the last one.
+void QueueSounds(SoundSource *source, uint64_t cycle, uint32_t start, uint32_t stop){
+    SoundEvent *event;
+
+    if ((start | stop) == 0){
+        return;
+    }
+    if (source->eventCount == MAX_SOUND_EVENTS){
+        event = &source->events[MAX_SOUND_EVENTS - 1];
+        event->start = (event->start & ~stop) | start;
+        event->stop = (event->stop & ~start) | stop;
+        return;
+    }
+    event = &source->events[source->eventCount];
+    event->cycle = cycle;
+    event->start = start;
+    event->stop = stop;
+    source->eventCount++;
+}
+
+static void ApplySoundEvent(SoundSource *source, const SoundEvent *event){
+    int sound = 0;
+
+    source->playing &= ~event->stop;
+    while (sound < SOUND_COUNT){
+        if (event->start & (1u << sound)){
+            StartSynthVoice(&source->synthVoices[sound], sound, audioRate);
+            source->samplePositions[sound] = 0;
+            source->playing |= 1u << sound;
+        }
+        sound++;
+    }
+}
+
+//Add count samples of everything the source is playing to mix, each voice with its own gain. Sounds that finish are taken off the playing list.
+static void MixSource(SoundSource *source, float *mix, int count){
+    static float voice[AUDIO_RING_SIZE];
+    int sound = 0;
+
+    while (sound < SOUND_COUNT){
+        if (source->playing & (1u << sound)){
+            float gain = source->gain * soundGains[sound];
+            int stillPlaying;
+
+            if (soundMode == SOUND_SYNTH){
+                memset(voice, 0, count * sizeof(float));
+                stillPlaying = RenderSynthVoice(&source->synthVoices[sound], voice, count, audioRate);
+                AccumulateMix(mix, voice, gain, count);
+            }
+            else if (bank[sound].data != NULL){
+                int written = Resample(bank[sound].resampler, bank[sound].data, bank[sound].length, sound == SOUND_UFO, &source->samplePositions[sound], voice, count);
+                AccumulateMix(mix, voice, gain, written);
+                stillPlaying = (written == count);
+            }
+            else{
+                stillPlaying = 0;
+            }
+
+            if (stillPlaying == 0){
+                source->playing &= ~(1u << sound);
+            }
+        }
+        sound++;
+    }
+}
+
+//Mix count samples of one source into mix, starting and stopping its voices at the sample matching each queued event's cycle. The source has got from its last update up to the given cycle in that time.
+static void UpdateSource(SoundSource *source, uint64_t cycle, float *mix, int count){
+    uint64_t span = 0;
+    int position = 0;
+    int i = 0;
+
+    //Nothing to place the events against yet, so they just happen now.
+    if (source->synced == 0 || cycle < source->mixedCycle){
+        while (i < source->eventCount){
+            ApplySoundEvent(source, &source->events[i]);
+            i++;
+        }
+        source->eventCount = 0;
+        source->synced = 1;
+    }
+    else{
+        span = cycle - source->mixedCycle;
+    }
+
+    //Mix up to each event, apply it, and carry on. Events come in cycle order, since they're queued as the CPU runs.
+    while (i < source->eventCount){
+        const SoundEvent *event = &source->events[i];
+        int offset = span > 0 && event->cycle > source->mixedCycle ? (int) ((event->cycle - source->mixedCycle) * count / span) : 0;
+        if (offset > count){
+            offset = count;
+        }
+        if (offset > position){
+            MixSource(source, &mix[position], offset - position);
+            position = offset;
+        }
+        ApplySoundEvent(source, event);
+        i++;
+    }
+    source->eventCount = 0;
+    if (count > position){
+        MixSource(source, &mix[position], count - position);
+    }
+    source->mixedCycle = cycle;
+}
+
+/*
+Mix and queue the sound from the last update up to the given cycle count of each source's machine, which run at the given number of cycles per second. The first source's machine sets how many samples that is; the others (machines run side by side, which have got through the same time) are fitted to it.
+*/
+void UpdateSound(SoundSource **sources, const uint64_t *cycles, int sourceCount, uint64_t cyclesPerSecond){
+    static float mix[AUDIO_RING_SIZE];
+    static int16_t samples[AUDIO_RING_SIZE];
+    SoundSource *first = sources[0];
+    uint64_t rate;
+    double adjust;
+    int count = 0;
+    int i = 0;
+
+    if (soundMode == SOUND_OFF){
+        while (i < sourceCount){
+            sources[i]->eventCount = 0;
+            sources[i]->playing = 0;
+            i++;
+        }
+        return;
+    }
+
+    if (first->synced && cycles[0] >= first->mixedCycle){
+        //Dynamic rate control. The emulation is paced by one clock and the audio device plays by another, so the queue slowly fills up or drains even when both are right. Mixing slightly more samples per cycle when the queue is short, and fewer when it's long, holds it at the target. Half a percent either way is too little to hear, since it only moves where sounds start and stop, not their pitch.
+        //A WAV file has no clock of its own. It gets exactly the samples the emulated time covers, so the same run always writes the same file.
+        adjust = wav.file != NULL ? 0.0 : (double) (AudioTarget() - AudioQueued()) / AudioTarget();
+        if (adjust > 1.0){
+            adjust = 1.0;
+        }
+        if (adjust < -1.0){
+            adjust = -1.0;
+        }
+        rate = (uint64_t) (audioRate * 1024.0 * (1.0 + MAX_RATE_ADJUST * adjust));
+
+        leftover += (cycles[0] - first->mixedCycle) * rate;
+        count = (int) (leftover / (cyclesPerSecond * 1024));
+        leftover -= (uint64_t) count * cyclesPerSecond * 1024;
+        if (count > AUDIO_RING_SIZE){
+            count = AUDIO_RING_SIZE;
+        }
+    }
+    else{
+        leftover = 0;
+    }
+
+    memset(mix, 0, count * sizeof(float));
+    while (i < sourceCount){
+        UpdateSource(sources[i], cycles[i], mix, count);
+        i++;
+    }
+    ConvertMix(samples, mix, MASTER_VOLUME * masterVolume, count);
+
+    if (wav.file != NULL){
+        WriteWav(&wav, samples, count);
+    }
+    else{
+        WriteAudio(samples, count);
+    }
+}
+
+//Silence one machine at once, for when another machine takes over the sound. The next update syncs up with it again.
+void StopAllSounds(SoundSource *source){
+    source->eventCount = 0;
+    source->playing = 0;
+    source->synced = 0;
+}
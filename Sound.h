@@ -0,0 +1,37 @@
+#include "Synth.h"
+
+//Sounds, numbered as the files in Sounds/ are.
+enum {SOUND_UFO, SOUND_SHOT, SOUND_PLAYER_DEATH, SOUND_INVADER_DEATH, SOUND_FLEET1, SOUND_FLEET2, SOUND_FLEET3, SOUND_FLEET4, SOUND_UFO_HIT, SOUND_EXTRA_LIFE, SOUND_COUNT};
+
+//Where sounds come from: the built in synthesizer, the WAV files in Sounds/, or nowhere.
+enum {SOUND_SYNTH, SOUND_SAMPLES, SOUND_OFF};
+
+#define MAX_SOUND_EVENTS 64
+
+//Sounds started and stopped (a bit per sound number) by one port write.
+typedef struct SoundEvent{
+    uint64_t    cycle;
+    uint32_t    start;
+    uint32_t    stop;
+} SoundEvent;
+
+//One machine's sound board: its voices, and the port writes waiting to be mixed. Any number of these can be mixed together.
+typedef struct SoundSource{
+    SoundEvent  events[MAX_SOUND_EVENTS];
+    int         eventCount;
+    uint32_t    playing;                        //Bit per sound.
+    SynthVoice  synthVoices[SOUND_COUNT];
+    uint64_t    samplePositions[SOUND_COUNT];   //How far into each sample, 32.32 fixed point, in the sample's own rate.
+    uint64_t    mixedCycle;                     //Cycle count everything up to which has been mixed.
+    int         synced;                         //0 until the first update.
+    float       gain;                           //Volume of the whole machine.
+} SoundSource;
+
+int InitSound(int, const char *);
+int CloseSound(void);
+void SetMasterVolume(float);
+void SetSoundGain(int, float);
+void InitSoundSource(SoundSource *);
+void QueueSounds(SoundSource *, uint64_t, uint32_t, uint32_t);
+void UpdateSound(SoundSource **, const uint64_t *, int, uint64_t);
+void StopAllSounds(SoundSource *);
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "8080Emulator.h"
+#include "Stats.h"
+#include "Terminal.h"
+#include "Timing.h"
+
+EmulatorStats stats;
+int statsEnabled = 0;
+
+//Emulated frames per second of wall time, and how that compares to the real machine's 60. Updated once per second.
+double measuredFrameRate = 0.0;
+double measuredSpeed = 0.0;
+
+//Call once per frame. Once per second, updates the measured speed and prints a line if stats are enabled: to stderr, or under the picture in terminal mode (see TerminalStatus). Returns 1 when a new measurement was made.
+int ReportStats(void){
+    static EmulatorStats previous;
+    static Uint32 lastReport = 0;
+    char line[1024];
+    Uint32 now;
+    double elapsed;
+    uint64_t inputEvents;
+
+    now = SDL_GetTicks();
+    if (lastReport == 0){
+        lastReport = now;
+        previous = stats;
+        return 0;
+    }
+    if (now - lastReport < 1000){
+        return 0;
+    }
+
+    elapsed = (now - lastReport) / 1000.0;
+    measuredFrameRate = (stats.frames - previous.frames) / elapsed;
+    measuredSpeed = measuredFrameRate / 60.0;
+
+    if (statsEnabled){
+        inputEvents = stats.inputEvents - previous.inputEvents;
+        snprintf(line, sizeof(line), "frames %.1f/s (%.2fx) | drawn %llu/s | unchanged (skipped) %llu/s, %llu total | behind (skipped) %llu/s, %llu total | overran %llu/s, %llu total | audio latency %.1f ms (target %.1f), underran %llu/s, %llu total, overran %llu total | input delay %.1f ms | waiting: sleep %.0f%% spin %.0f%%",
+               measuredFrameRate,
+               measuredSpeed,
+               (unsigned long long) (stats.renders - previous.renders),
+               (unsigned long long) (stats.unchangedRenders - previous.unchangedRenders),
+               (unsigned long long) stats.unchangedRenders,
+               (unsigned long long) (stats.skippedRenders - previous.skippedRenders),
+               (unsigned long long) stats.skippedRenders,
+               (unsigned long long) (stats.overruns - previous.overruns),
+               (unsigned long long) stats.overruns,
+               stats.audioLatency,
+               stats.audioTarget,
+               (unsigned long long) (stats.audioUnderruns - previous.audioUnderruns),
+               (unsigned long long) stats.audioUnderruns,
+               (unsigned long long) stats.audioOverruns,
+               inputEvents > 0 ? 1000.0 * TimerSeconds(stats.inputDelayTicks - previous.inputDelayTicks) / inputEvents : 0.0,
+               100.0 * TimerSeconds(stats.sleepTicks - previous.sleepTicks) / elapsed,
+               100.0 * TimerSeconds(stats.spinTicks - previous.spinTicks) / elapsed);
+        TerminalStatus(line);
+    }
+
+    previous = stats;
+    lastReport = now;
+    return 1;
+}
@@ -0,0 +1,23 @@
+//Counters shown by -stats. Totals since startup, the report shows how much each one went up in the last second.
+typedef struct EmulatorStats{
+    uint64_t    frames;             //Frames emulated (both interrupts run).
+    uint64_t    renders;            //Screen updates that were converted, uploaded and presented.
+    uint64_t    unchangedRenders;   //Screen updates skipped because VRAM hadn't changed.
+    uint64_t    skippedRenders;     //Screen updates skipped because emulation was behind the wall clock.
+    uint64_t    overruns;           //Frames the game didn't finish in time (see InvadersIO).
+    uint64_t    audioUnderruns;     //Times the audio device ran out of samples and played silence, and times samples were dropped because the queue was full.
+    uint64_t    audioOverruns;
+    double      audioLatency;       //Current audio latency and what it's aiming for, in milliseconds. Snapshots rather than totals.
+    double      audioTarget;
+    uint64_t    inputEvents;        //Key presses and controller changes, and how long they took in total to reach the machine, in performance counter ticks.
+    uint64_t    inputDelayTicks;
+    uint64_t    sleepTicks;         //Time spent sleeping and spinning while waiting for the next deadline, in performance counter ticks.
+    uint64_t    spinTicks;
+} EmulatorStats;
+
+extern EmulatorStats stats;
+extern int statsEnabled;
+extern double measuredFrameRate;
+extern double measuredSpeed;
+
+int ReportStats(void);
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include "Sound.h"
+
+/*
+Sound synthesis, standing in for the analog sound circuits on the board, so no sample files are needed.
+Each effect is a patch: a square or triangle tone and/or filtered noise, with the few things the circuits do to them (pitch slides, wobble, gating, decay).
+It's an approximation by ear rather than a circuit simulation, but it's cheap: a handful of multiplies per voice per sample.
+*/
+
+#define PI 3.14159265358979323846
+
+static const SynthPatch patches[SOUND_COUNT] = {
+    //UFO: a siren that wobbles up and down for as long as the UFO is on screen.
+    {WAVE_TRIANGLE, 520.0f, 520.0f, 0.30f, 7.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.25f},
+    //Shot: a falling whistle over a burst of hiss.
+    {WAVE_SQUARE, 1400.0f, 250.0f, 0.0f, 0.0f, 0.0f, 0.5f, 4000.0f, 0.10f, 0.30f, 0.25f},
+    //Player death: a long, low explosion with a wobbling drone under it.
+    {WAVE_SQUARE, 90.0f, 40.0f, 0.25f, 12.0f, 0.0f, 1.0f, 700.0f, 0.45f, 1.40f, 0.50f},
+    //Invader death: a short, sharp burst of noise.
+    {WAVE_SQUARE, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 2500.0f, 0.10f, 0.35f, 0.55f},
+    //Fleet movement: four low thumps, each a step lower.
+    {WAVE_SQUARE, 98.0f, 90.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.05f, 0.14f, 0.45f},
+    {WAVE_SQUARE, 87.0f, 80.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.05f, 0.14f, 0.45f},
+    {WAVE_SQUARE, 78.0f, 72.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.05f, 0.14f, 0.45f},
+    {WAVE_SQUARE, 73.0f, 67.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.05f, 0.14f, 0.45f},
+    //UFO hit: a fast warble that dies away.
+    {WAVE_SQUARE, 900.0f, 600.0f, 0.45f, 14.0f, 0.0f, 0.0f, 0.0f, 0.50f, 1.10f, 0.22f},
+    //Extra life: a high beep, switched on and off.
+    {WAVE_SQUARE, 1500.0f, 1500.0f, 0.0f, 0.0f, 8.0f, 0.0f, 0.0f, 0.0f, 0.60f, 0.15f}
+};
+
+//Set a voice up to play a sound from the start.
+void StartSynthVoice(SynthVoice *voice, int sound, int rate){
+    const SynthPatch *patch = &patches[sound];
+    double samples = patch->length * rate;
+
+    voice->patch = patch;
+    voice->samplesLeft = patch->length > 0.0f ? (int) samples : -1;
+    voice->phase = 0.0;
+    voice->vibratoPhase = 0.0;
+    voice->gatePhase = 0.0;
+    voice->frequency = patch->startFrequency;
+    voice->frequencyStep = (patch->length > 0.0f && patch->startFrequency > 0.0f) ? pow(patch->endFrequency / patch->startFrequency, 1.0 / samples) : 1.0;
+    voice->level = patch->volume;
+    voice->levelStep = patch->decay > 0.0f ? exp(-1.0 / (patch->decay * rate)) : 1.0;
+    voice->noiseFilter = 0.0;
+    voice->noiseAlpha = 1.0 - exp(-2.0 * PI * patch->noiseCutoff / rate);
+    voice->noiseGain = 0.4 * sqrt((2.0 - voice->noiseAlpha) / voice->noiseAlpha);
+    voice->noiseShift = 0x1FFFF;
+}
+
+//Add count samples of the voice to mix. Returns 0 once the sound has finished.
+int RenderSynthVoice(SynthVoice *voice, float *mix, int count, int rate){
+    const SynthPatch *patch = voice->patch;
+    double step = 1.0 / rate;
+    int i = 0;
+
+    if (voice->samplesLeft >= 0 && count > voice->samplesLeft){
+        count = voice->samplesLeft;
+    }
+
+    while (i < count){
+        double sample = 0.0;
+
+        if (patch->startFrequency > 0.0f){
+            double frequency = voice->frequency;
+            double tone;
+
+            //Vibrato follows a triangle, which is what the slow oscillators on the board put out.
+            if (patch->vibratoDepth > 0.0f){
+                double wobble = voice->vibratoPhase < 0.5 ? 4.0 * voice->vibratoPhase - 1.0 : 3.0 - 4.0 * voice->vibratoPhase;
+                frequency *= 1.0 + patch->vibratoDepth * wobble;
+                voice->vibratoPhase += patch->vibratoRate * step;
+                voice->vibratoPhase -= (int) voice->vibratoPhase;
+            }
+
+            if (patch->wave == WAVE_SQUARE){
+                tone = voice->phase < 0.5 ? 1.0 : -1.0;
+            }
+            else{
+                tone = voice->phase < 0.5 ? 4.0 * voice->phase - 1.0 : 3.0 - 4.0 * voice->phase;
+            }
+            voice->phase += frequency * step;
+            voice->phase -= (int) voice->phase;
+            voice->frequency *= voice->frequencyStep;
+
+            if (patch->gateRate > 0.0f){
+                if (voice->gatePhase >= 0.5){
+                    tone = 0.0;
+                }
+                voice->gatePhase += patch->gateRate * step;
+                voice->gatePhase -= (int) voice->gatePhase;
+            }
+            sample += tone * (1.0 - patch->noise);
+        }
+
+        if (patch->noise > 0.0f){
+            //Taps 17 and 12, shifted once per sample, then low pass filtered.
+            uint32_t bit = ((voice->noiseShift >> 16) ^ (voice->noiseShift >> 11)) & 1;
+            voice->noiseShift = ((voice->noiseShift << 1) | bit) & 0x1FFFF;
+            voice->noiseFilter += voice->noiseAlpha * ((bit ? 1.0 : -1.0) - voice->noiseFilter);
+            sample += voice->noiseFilter * voice->noiseGain * patch->noise;
+        }
+
+        mix[i] += (float) (sample * voice->level);
+        voice->level *= voice->levelStep;
+        i++;
+    }
+
+    if (voice->samplesLeft >= 0){
+        voice->samplesLeft -= count;
+        return voice->samplesLeft > 0;
+    }
+    return 1;
+}
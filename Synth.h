@@ -0,0 +1,35 @@
+enum {WAVE_SQUARE, WAVE_TRIANGLE};
+
+//How one of the board's sound circuits is imitated: a tone (which can slide and wobble in pitch, and be switched on and off), noise, or both, under a decaying envelope.
+typedef struct SynthPatch{
+    int         wave;
+    float       startFrequency;     //Hz. 0 for no tone.
+    float       endFrequency;       //The pitch slides exponentially from start to end over the length of the sound.
+    float       vibratoDepth;       //Pitch wobble, as a fraction of the pitch.
+    float       vibratoRate;        //Hz.
+    float       gateRate;           //Hz at which the tone is switched on and off. 0 leaves it on.
+    float       noise;              //Amount of noise, 0-1.
+    float       noiseCutoff;        //Hz. Low pass filter on the noise, which goes from hiss to rumble as this goes down.
+    float       decay;              //Seconds for the volume to fall to 1/e. 0 keeps it steady.
+    float       length;             //Seconds. 0 loops until stopped.
+    float       volume;
+} SynthPatch;
+
+typedef struct SynthVoice{
+    const SynthPatch    *patch;
+    int                 samplesLeft;    //-1 for a looping sound.
+    double              phase;          //Position within a cycle of the tone, vibrato and gate, 0-1.
+    double              vibratoPhase;
+    double              gatePhase;
+    double              frequency;
+    double              frequencyStep;  //Multiplies the frequency every sample.
+    double              level;
+    double              levelStep;      //Multiplies the level every sample.
+    double              noiseFilter;
+    double              noiseAlpha;
+    double              noiseGain;      //Filtering takes power out of the noise, this puts it back, so the cutoff doesn't change the loudness.
+    uint32_t            noiseShift;     //17 bit shift register, like the noise source on the board.
+} SynthVoice;
+
+void StartSynthVoice(SynthVoice *, int, int);
+int RenderSynthVoice(SynthVoice *, float *, int, int);
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "8080Emulator.h"
+#include "Overlay.h"
+#include "Terminal.h"
+#include "InvadersMachine.h"
+#include "Stats.h"
+
+/*
+Text mode renderer, for looking at a machine over SSH or anywhere else without a display.
+The screen (224x256 once rotated) is drawn with Unicode braille characters, each of which holds 2x4 dots, so it takes up 112x64 characters.
+Braille dot numbering, and the bit each dot sets in the character (U+2800 + bits):
+    1 4     0x01 0x08
+    2 5     0x02 0x10
+    3 6     0x04 0x20
+    7 8     0x40 0x80
+Only characters that changed since the previous frame are written, so a mostly static screen costs almost nothing to send.
+*/
+
+#define TERMINAL_COLUMNS 112
+#define TERMINAL_ROWS 64
+
+//Previous frame, one entry per character: braille dots in the low byte, overlay colour in the high byte. 0xFFFF forces a redraw.
+static uint16_t previousCells[TERMINAL_ROWS * TERMINAL_COLUMNS];
+
+//Escape sequences and characters for a whole frame are collected here and written in one go. Worst case is a cursor move, a colour change and a 3 byte character for every cell.
+static char outputBuffer[TERMINAL_ROWS * TERMINAL_COLUMNS * 24 + 64];
+
+//Dots for the 4 pixels of one screen column within a character, indexed by a nibble of VRAM (bit 3 is the top pixel, bit 0 the bottom one).
+static uint8_t leftDots[16];
+static uint8_t rightDots[16];
+
+//ANSI colour for each overlay colour.
+static const char *ansiColours[OVERLAY_COLOURS] = {"\x1b[30m", "\x1b[97m", "\x1b[91m", "\x1b[92m"};
+
+static int terminalOpen = 0;
+
+void TerminalInit(void){
+    //Dot bits for the top to bottom pixel of the left and right columns of a braille character.
+    static const uint8_t leftBits[4] = {0x01, 0x02, 0x04, 0x40};
+    static const uint8_t rightBits[4] = {0x08, 0x10, 0x20, 0x80};
+    int nibble;
+    int y;
+
+    for (nibble = 0; nibble < 16; nibble++){
+        leftDots[nibble] = rightDots[nibble] = 0;
+        for (y = 0; y < 4; y++){
+            if (nibble & (0x8 >> y)){
+                leftDots[nibble] |= leftBits[y];
+                rightDots[nibble] |= rightBits[y];
+            }
+        }
+    }
+
+    memset(previousCells, 0xFF, sizeof(previousCells));
+
+    //Clear the screen and hide the cursor. Put the terminal back the way it was on exit. Ctrl+C is left to SDL, which turns it into SDL_QUIT, so it goes through the same cleanup as closing the window (the movie and WAV file are finished, and so on) before getting here.
+    printf("\x1b[2J\x1b[?25l");
+    fflush(stdout);
+    terminalOpen = 1;
+    atexit(TerminalClose);
+}
+
+void TerminalRender(State8080 *state){
+    static uint64_t lastHash = 0;
+    static int lastOverlay = -1;
+    uint64_t hash = VRAMHash(state->memory);
+    const uint8_t *vram = &state->memory[0x2400];
+    char *out = outputBuffer;
+    int cursorX = -1;
+    int cursorY = -1;
+    int colour = -1;
+    int x;
+    int y;
+
+    //Nothing to compare cell by cell if the VRAM is exactly the same as last time.
+    if (hash == lastHash && currentOverlay == lastOverlay){
+        stats.unchangedRenders++;
+        return;
+    }
+    lastHash = hash;
+    lastOverlay = currentOverlay;
+    stats.renders++;
+
+    for (y = 0; y < TERMINAL_ROWS; y++){
+        //Screen rows 4y to 4y + 3 are VRAM pixel columns 255 - 4y down to 252 - 4y, which are always 4 bits within the same byte.
+        int column = 252 - 4 * y;
+        int byte = column >> 3;
+        int shift = column & 0x7;
+
+        for (x = 0; x < TERMINAL_COLUMNS; x++){
+            //Screen columns 2x and 2x + 1 are VRAM rows 2x and 2x + 1.
+            uint8_t left = (vram[(2 * x) * 32 + byte] >> shift) & 0xF;
+            uint8_t right = (vram[(2 * x + 1) * 32 + byte] >> shift) & 0xF;
+            uint8_t dots = leftDots[left] | rightDots[right];
+            uint16_t cell = dots;
+
+            //Colour the character by the overlay under its top left pixel, or its top right pixel if the left column is empty. Overlay strips never start or end partway down a character.
+            if (dots){
+                int pixel = (2 * x) * 256 + column + 3;
+                if (left == 0){
+                    pixel += 256;
+                }
+                cell |= overlayColour[pixel] << 8;
+            }
+
+            if (cell == previousCells[y * TERMINAL_COLUMNS + x]){
+                continue;
+            }
+            previousCells[y * TERMINAL_COLUMNS + x] = cell;
+
+            //Only move the cursor if it isn't already there from the previous character.
+            if (cursorX != x || cursorY != y){
+                out += sprintf(out, "\x1b[%d;%dH", y + 1, x + 1);
+            }
+            if (dots == 0){
+                *out++ = ' ';
+            }
+            else{
+                if (colour != cell >> 8){
+                    colour = cell >> 8;
+                    out += sprintf(out, "%s", ansiColours[colour]);
+                }
+                //UTF-8 encoding of U+2800 + dots.
+                *out++ = (char) 0xE2;
+                *out++ = (char) (0xA0 | (dots >> 6));
+                *out++ = (char) (0x80 | (dots & 0x3F));
+            }
+            cursorX = x + 1;
+            cursorY = y;
+        }
+    }
+
+    if (out != outputBuffer){
+        fwrite(outputBuffer, 1, out - outputBuffer, stdout);
+        fflush(stdout);
+    }
+}
+
+//Print a status line (speed, -stats). Under the picture while the terminal renderer is running, where it doesn't get in the way of the cells being redrawn, otherwise to stderr. Wrapping is turned off while it's written, since a line that wrapped off the bottom would scroll the picture up.
+void TerminalStatus(const char *line){
+    if (terminalOpen){
+        printf("\x1b[%d;1H\x1b[2K\x1b[?7l%s\x1b[?7h", TERMINAL_ROWS + 1, line);
+        fflush(stdout);
+    }
+    else{
+        fprintf(stderr, "%s\n", line);
+        fflush(stderr);
+    }
+}
+
+void TerminalClose(void){
+    if (terminalOpen){
+        //Reset colours, show the cursor again and move below the picture.
+        printf("\x1b[0m\x1b[?25h\x1b[%d;1H\n", TERMINAL_ROWS + 1);
+        fflush(stdout);
+        terminalOpen = 0;
+    }
+}
@@ -0,0 +1,4 @@
+void TerminalInit(void);
+void TerminalRender(State8080 *);
+void TerminalStatus(const char *);
+void TerminalClose(void);
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "Timing.h"
+#include "Stats.h"
+
+/*
+Wall clock timing, using SDL's performance counter (a monotonic, high resolution clock). clock() is no good for this, since it measures the CPU time used by the process rather than real time.
+Waiting is done by sleeping until shortly before the deadline, then spinning for the last bit. Sleeping is cheap but the OS may wake us up late, spinning is exact but keeps a core busy.
+*/
+
+//How long before a deadline to stop sleeping and start spinning. It follows how late sleeps actually wake up on this system (around 0.1 ms on Linux, up to a millisecond or so on Windows), plus some headroom, within these bounds.
+#define MIN_SPIN_MARGIN 0.00025
+#define MAX_SPIN_MARGIN 0.004
+#define SPIN_HEADROOM 0.0002
+
+static Uint64 frequency;
+static Uint64 spinMargin;
+
+void InitTiming(void){
+    frequency = SDL_GetPerformanceFrequency();
+    spinMargin = TimerTicks(0.002);
+}
+
+Uint64 TimerNow(void){
+    return SDL_GetPerformanceCounter();
+}
+
+double TimerSeconds(Uint64 ticks){
+    return (double) ticks / frequency;
+}
+
+Uint64 TimerTicks(double seconds){
+    return (Uint64) (seconds * frequency);
+}
+
+void InitPacer(FramePacer *pacer, double hz){
+    pacer->period = TimerTicks(1.0 / hz);
+    pacer->next = TimerNow() + pacer->period;
+}
+
+//Change the rate, starting the new period from now.
+void SetPacerRate(FramePacer *pacer, double hz){
+    pacer->period = TimerTicks(1.0 / hz);
+    pacer->next = TimerNow() + pacer->period;
+}
+
+//Wait until the performance counter reaches the deadline.
+void WaitUntil(Uint64 deadline){
+    Uint64 now = TimerNow();
+    Uint64 start = now;
+
+    //Sleep in whole milliseconds while there's at least a millisecond to spare before the margin.
+    while (now + spinMargin < deadline){
+        Uint32 milliseconds = (Uint32) (TimerSeconds(deadline - spinMargin - now) * 1000.0);
+        Uint64 requested;
+        Uint64 late;
+        if (milliseconds == 0){
+            break;
+        }
+        requested = now + TimerTicks(milliseconds / 1000.0);
+        SDL_Delay(milliseconds);
+        now = TimerNow();
+
+        //Grow the margin quickly if the sleep woke up later than it allows for, and let it shrink slowly otherwise. A single very late wakeup (the OS was busy) doesn't keep it high for long.
+        late = (now > requested ? now - requested : 0) + TimerTicks(SPIN_HEADROOM);
+        if (late > spinMargin){
+            spinMargin += (late - spinMargin) / 2;
+        }
+        else{
+            spinMargin -= (spinMargin - late) / 16;
+        }
+        if (spinMargin < TimerTicks(MIN_SPIN_MARGIN)){
+            spinMargin = TimerTicks(MIN_SPIN_MARGIN);
+        }
+        if (spinMargin > TimerTicks(MAX_SPIN_MARGIN)){
+            spinMargin = TimerTicks(MAX_SPIN_MARGIN);
+        }
+    }
+    stats.sleepTicks += now - start;
+
+    //Spin for the rest.
+    start = now;
+    while (now < deadline){
+        now = TimerNow();
+    }
+    stats.spinTicks += now - start;
+}
+
+//Wait for the next deadline. Returns how late we were for it, in ticks (0 if we had to wait), which is how far emulation has fallen behind the wall clock.
+Uint64 WaitPacer(FramePacer *pacer){
+    Uint64 now = TimerNow();
+    Uint64 late = now > pacer->next ? now - pacer->next : 0;
+
+    //If emulation has fallen more than a few periods behind (a breakpoint, the window being dragged etc.), don't try to catch up by running flat out. Start counting again from now.
+    if (now > pacer->next + 4 * pacer->period){
+        pacer->next = now;
+    }
+
+    WaitUntil(pacer->next);
+    pacer->next += pacer->period;
+    return late;
+}
@@ -0,0 +1,14 @@
+//Paces a loop to a fixed rate against the wall clock. Each call to WaitPacer returns at the next deadline, one period after the previous one.
+typedef struct FramePacer{
+    Uint64      period;     //Performance counter ticks between deadlines.
+    Uint64      next;       //Next deadline.
+} FramePacer;
+
+void InitTiming(void);
+Uint64 TimerNow(void);
+double TimerSeconds(Uint64);
+Uint64 TimerTicks(double);
+void InitPacer(FramePacer *, double);
+void SetPacerRate(FramePacer *, double);
+void WaitUntil(Uint64);
+Uint64 WaitPacer(FramePacer *);
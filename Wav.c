@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "Wav.h"
+
+/*
+WAV file layout: a RIFF header, a "fmt " chunk describing the samples, then a "data" chunk with the samples themselves. All numbers are little endian.
+The sizes in the header are only known once the last sample is written, so the header is written twice, like a movie's.
+*/
+
+#define WAV_HEADER_SIZE 44
+#define WAV_BUFFER_SIZE 4096    //Samples converted to little endian at a time.
+
+static void PutNumber(uint8_t *buffer, uint32_t value, int bytes){
+    int i = 0;
+
+    while (i < bytes){
+        buffer[i] = (value >> (i * 8)) & 0xFF;
+        i++;
+    }
+}
+
+static int WriteHeader(WavFile *wav){
+    uint8_t buffer[WAV_HEADER_SIZE];
+    uint32_t dataSize = wav->samples * 2;
+
+    memcpy(buffer, "RIFF", 4);
+    PutNumber(&buffer[4], 36 + dataSize, 4);
+    memcpy(&buffer[8], "WAVEfmt ", 8);
+    PutNumber(&buffer[16], 16, 4);              //Size of the rest of the fmt chunk.
+    PutNumber(&buffer[20], 1, 2);               //PCM.
+    PutNumber(&buffer[22], 1, 2);               //Channels.
+    PutNumber(&buffer[24], wav->rate, 4);
+    PutNumber(&buffer[28], wav->rate * 2, 4);   //Bytes per second.
+    PutNumber(&buffer[32], 2, 2);               //Bytes per sample, for all channels.
+    PutNumber(&buffer[34], 16, 2);              //Bits per sample.
+    memcpy(&buffer[36], "data", 4);
+    PutNumber(&buffer[40], dataSize, 4);
+
+    if (fseek(wav->file, 0, SEEK_SET) != 0 || fwrite(buffer, 1, WAV_HEADER_SIZE, wav->file) != WAV_HEADER_SIZE){
+        return 1;
+    }
+    return 0;
+}
+
+//Create the file. Returns 0 on success.
+int OpenWav(WavFile *wav, const char *path, int rate){
+    wav->file = fopen(path, "wb");
+    if (wav->file == NULL){
+        printf("Error: could not create WAV file %s!\n", path);
+        return 1;
+    }
+    wav->rate = rate;
+    wav->samples = 0;
+    if (WriteHeader(wav) != 0){
+        printf("Error: could not write to WAV file %s!\n", path);
+        fclose(wav->file);
+        wav->file = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+//Append samples. Returns 0 on success.
+int WriteWav(WavFile *wav, const int16_t *samples, int count){
+    uint8_t buffer[WAV_BUFFER_SIZE * 2];
+
+    while (count > 0){
+        int chunk = count < WAV_BUFFER_SIZE ? count : WAV_BUFFER_SIZE;
+        int i = 0;
+        while (i < chunk){
+            PutNumber(&buffer[i * 2], (uint16_t) samples[i], 2);
+            i++;
+        }
+        if (fwrite(buffer, 2, chunk, wav->file) != (size_t) chunk){
+            return 1;
+        }
+        wav->samples += chunk;
+        samples += chunk;
+        count -= chunk;
+    }
+    return 0;
+}
+
+//Fill in the sizes and close the file. Returns 0 on success.
+int CloseWav(WavFile *wav){
+    int result;
+
+    if (wav->file == NULL){
+        return 0;
+    }
+    result = WriteHeader(wav);
+    if (fclose(wav->file) != 0){
+        result = 1;
+    }
+    wav->file = NULL;
+    return result;
+}
@@ -0,0 +1,10 @@
+//Sound written to a WAV file instead of the audio device: 16 bit mono PCM at a fixed rate.
+typedef struct WavFile{
+    FILE        *file;
+    int         rate;
+    uint32_t    samples;    //Written so far.
+} WavFile;
+
+int OpenWav(WavFile *, const char *, int);
+int WriteWav(WavFile *, const int16_t *, int);
+int CloseWav(WavFile *);
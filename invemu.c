@@ -3,55 +3,185 @@
 #include <math.h>
 #include <string.h>
 #include <stdint.h>
-#include <time.h>
 #include "8080Emulator.h"
 #include "InvadersMachine.h"
+#include "Overlay.h"
+#include "Mosaic.h"
+#include "Terminal.h"
+#include "Stats.h"
+#include "Timing.h"
+#include "Movie.h"
+#include "Checksum.h"
+#include "Controller.h"
+#include "Sound.h"
+#include "Audio.h"
+#include "Rom.h"
+#include "Machines.h"
+#include "Bundle.h"
 #include <SDL.h>
 
 int LoadFile(uint8_t *);
+int LoadImage(const char *, uint8_t *);
+int ParseArguments(int, char **);
+void CheckHotkeys(void);
+void SetSpeedMode(int);
+Uint64 WaitNext(void);
+int RenderDue(void);
+int FrameSkipDue(Uint64);
+void ShowSpeed(SDL_Window *);
+void RunAhead(State8080 *, SDL_Window *, SDL_Renderer *, SDL_Texture *);
+int KeyPressed(SDL_Scancode, uint8_t *);
+int PollEvents(InvadersIO *);
+void InitMachine(State8080 *, InvadersIO *, SoundSource *);
+int RunMosaic(State8080 *);
+int StartMovie(State8080 *, InvadersIO *);
+void MovieFrame(State8080 *, InvadersIO *);
+int FinishMovie(State8080 *);
 
 const int fileoutputflag = 0;
 const int printflag = 0;
 const int cpmflag = 0;
 
-uint16_t RAMoffset;
+//Where the picture goes. None runs headless, without sound either.
+enum {VIDEO_SDL, VIDEO_TERMINAL, VIDEO_NONE};
+
+//Which machines in the mosaic are heard: the one with focus, or all of them.
+enum {MOSAIC_SOUND_FOCUS, MOSAIC_SOUND_ALL};
+
+//How fast emulation runs: real time, a multiple of real time, or as fast as the host can go.
+enum {SPEED_NORMAL, SPEED_TURBO, SPEED_UNCAPPED};
+
+//Command line options.
+const MachineDescription *gameOption = NULL;    //NULL runs Space Invaders.
+int overlayOption = -1;         //-1 uses the game's own overlay.
+int videoOption = VIDEO_SDL;
+int soundOption = SOUND_SYNTH;
+int mosaicOption = 0;           //Number of machines to show in the mosaic viewer. 0 runs a single machine in its own window.
+int mosaicColumnsOption = 0;    //0 picks a roughly square grid.
+int thumbScaleOption = 2;
+int thumbRateOption = 15;       //Thumbnail refreshes per second.
+int mosaicSoundOption = MOSAIC_SOUND_FOCUS;
+int speedOption = SPEED_NORMAL;
+int turboOption = 4;            //Speed multiplier in turbo mode.
+int previewRateOption = 10;     //Screen updates per second in uncapped mode.
+int deterministicOption = 0;    //Sample input only once per frame, so runs can be repeated exactly.
+uint64_t framesOption = 0;      //Stop after this many frames and print the machine hash. 0 runs until the window is closed.
+const char *recordOption = NULL;    //Movie file to record input to, or play it back from.
+const char *playOption = NULL;
+int clockOption = 1;            //CPU clock multiplier.
+int runAheadOption = 0;         //Frames to run ahead. 0 turns run-ahead off.
+int frameSkipOption = 4;        //Most screen updates in a row that may be skipped when emulation falls behind. 0 never skips.
+int audioSyncOption = 0;        //Pace emulation from the audio device's clock rather than the wall clock.
+int minLatencyOption = 0;       //Bounds on the audio latency, in milliseconds. 0 goes as low as the host allows.
+int maxLatencyOption = 100;
+const char *wavOption = NULL;   //WAV file to write the sound to instead of playing it.
+const char *romDirOption = "Place Game ROMs Here";
+int romCheckOption = 1;         //Refuse ROM files whose checksums don't match a good dump.
+const char *bundleOption = NULL;    //Asset bundle to take the ROMs and sounds from, before looking for the files.
+
+//Wall clock pacing. pacerRate is the rate at normal speed: 120 (once per interrupt) for a single machine, 60 (once per frame) for the mosaic.
+FramePacer pacer;
+double pacerRate = 120.0;
+int speedMode = SPEED_NORMAL;
+SDL_Renderer *vsyncRenderer = NULL; //Renderer whose vsync is turned off when running faster than real time.
+
+//Movie being recorded or played back, and the machine hash as of the last frame recorded.
+Movie movie;
+uint64_t movieEndHash = 0;
 
 int main(int argc, char *argv[]){
     FILE *output;
     int i = 0;
-    clock_t start, stop;
-    int nextInterrupt = 1;
-    start = clock(); //Start counting clock ticks.
+    uint64_t nextEvent;
+    int event;
+    Uint64 late = 0;
 
-    //Init SDL.
-    SDL_Init(SDL_INIT_EVERYTHING);
+    if (ParseArguments(argc, argv) != 0){
+        return 1;
+    }
+
+    //Pick the game before any machine is set up, since that decides how the board is wired.
+    SelectMachine(gameOption != NULL ? gameOption : FindMachine("invaders"));
 
-    //Init State8080 and program counter.
+    //Init State8080 and the board hardware.
     State8080 mystate;
     State8080 *state = &mystate;
+    InvadersIO myio;
+    SoundSource mysound;
+    SoundSource *sources[1] = {&mysound};
+    InitMachine(state, &myio, &mysound);
+
+    //Load the ROMs into memory, before opening anything else, so a missing or bad file stops things straight away. The bundle stays mapped to the end, since the sounds are played from it.
+    if (bundleOption != NULL && OpenBundle(bundleOption) != 0){
+        return 1;
+    }
+    if (LoadFile(state->memory) == 0){
+        return 1;
+    }
 
-    state->pc = 0;
-    if (cpmflag == 1) state->pc = 0x100; //For CP/M cpu diagnostics.
+    //Init SDL. The terminal renderer is meant for machines without a display, so leave out video there, and when running headless.
+    if (videoOption != VIDEO_SDL){
+        SDL_Init(SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_EVENTS);
+    }
+    else{
+        SDL_Init(SDL_INIT_EVERYTHING);
+    }
+    InitTiming();
+
+    //Controllers are read by a thread of their own. Without them, the keyboard still works.
+    StartControllers();
+
+    //Open the audio device (and load the sample files, if they're used), once, before anything runs. Headless runs are silent, unless the sound is going to a WAV file.
+    //Pacing from the audio clock needs sound to be playing on the device.
+    SetAudioLatency(minLatencyOption, maxLatencyOption);
+    //Without a device, sound is just left off. A WAV file that was asked for and can't be written is an error, since a run that goes on without it would look like it worked.
+    if (InitSound(videoOption == VIDEO_NONE && wavOption == NULL ? SOUND_OFF : soundOption, wavOption) != 0){
+        if (wavOption != NULL){
+            return 1;
+        }
+        audioSyncOption = 0;
+    }
+    if (videoOption == VIDEO_NONE || soundOption == SOUND_OFF || mosaicOption > 0 || wavOption != NULL){
+        audioSyncOption = 0;
+    }
 
-    //Set all registers and condition codes to 0.
-    state->cc.z = state->cc.s = state->cc.p = state->cc.cy = state->cc.ac = state->a = state->b = state->c = state->d = state->e = state->h = state->l = state->sp = state->int_enable = state->cyclecount = 0;
+    //Build the colour overlay before the first frame is drawn.
+    SelectOverlay(overlayOption != -1 ? overlayOption : machine->overlay);
 
-    //Allocate 64K. 8K is used for the ROM, 8K for the RAM (of which 7K is VRAM). Processor has an address width of 16 bits however, so 2^16 = 65536 possible addresses.
-    state->memory = malloc(sizeof(uint8_t) * 0x10000);
-    while (i < 0x10000){
-        state->memory[i] = 0;
-        i++;
+    //Check a movie to be played back belongs to this ROM, or start recording one.
+    if (StartMovie(state, &myio) != 0){
+        return 1;
     }
 
-    if (cpmflag) state->memory[0x05] = 0xD3; state->memory[0x06] = 0x01; state->memory[0x07] = 0xC9; //Set OUT 1. Return after OS call (CP/M diagnostics only).
-
-    //Load ROM file(s) into memory.
-    RAMoffset = LoadFile(state->memory);
+    //Viewer mode, running many machines in one window.
+    if (mosaicOption > 0){
+        i = RunMosaic(state);
+        free(state->memory);
+        if (CloseSound() != 0){
+            i = 1;
+        }
+        CloseBundle();
+        StopControllers();
+        SDL_Quit();
+        return i;
+    }
 
-    //Create window
-    SDL_Window *window = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 896, 1024, SDL_WINDOW_SHOWN);
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    SDL_Texture *Game = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, 256, 224); //Use Stream for real emulation.
+    //Create window, or set up the terminal instead.
+    SDL_Window *window = NULL;
+    SDL_Renderer *renderer = NULL;
+    SDL_Texture *Game = NULL;
+    if (videoOption == VIDEO_TERMINAL){
+        TerminalInit();
+    }
+    else if (videoOption == VIDEO_NONE){
+        myio.soundEnabled = (wavOption != NULL);
+    }
+    else{
+        window = SDL_CreateWindow(machine->title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 896, 1024, SDL_WINDOW_SHOWN);
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+        Game = CreateScreenTexture(renderer); //Streaming texture, in the smallest pixel format the renderer supports.
+        vsyncRenderer = renderer;
+    }
 
     //For debugging.
     if (printflag){printf(" Ins#   pc   op  mnem   byte(s)\n");}
@@ -64,67 +194,116 @@ int main(int argc, char *argv[]){
 
     i = 0;
 
+    //Interrupts are paced against the wall clock, two per frame.
+    pacerRate = 120.0;
+    InitPacer(&pacer, pacerRate);
+    SetSpeedMode(speedOption);
+
     //while (state->pc != 0){ //For CPU diagnostics.
     while (1){
-        //CPU Diagnostics
-        if (cpmflag && state->pc == 5){
-            int z = 0;
-            if (state->c == 2){
-                printf("%c", state->e);
-            }
-            else if (state->c == 9){
-                while ((state->memory[((state->d << 8) | state->e) + z] != 0x24)){
-                    printf("%c", state->memory[((state->d << 8) | state->e) + z]);
-                    z++;
+        //Run the CPU up to the next scheduled event (interrupts etc.).
+        nextEvent = NextEventTime(&myio.scheduler);
+        while (state->cyclecount < nextEvent){
+            //CPU Diagnostics
+            if (cpmflag && state->pc == 5){
+                int z = 0;
+                if (state->c == 2){
+                    printf("%c", state->e);
+                }
+                else if (state->c == 9){
+                    while ((state->memory[((state->d << 8) | state->e) + z] != 0x24)){
+                        printf("%c", state->memory[((state->d << 8) | state->e) + z]);
+                        z++;
+                    }
+                    printf("\n");
                 }
-                printf("\n");
             }
-        }
 
-        //Print instruction count.
-        if (printflag){printf("%6d ", i);}
-        if (fileoutputflag){fprintf(output, "%6d ", i);} //Also print to file.
+            //Print instruction count.
+            if (printflag){printf("%6d ", i);}
+            if (fileoutputflag){fprintf(output, "%6d ", i);} //Also print to file.
 
-        //Emulate instruction
-        Emulate8080Op(state, output);
+            //Emulate instruction
+            Emulate8080Op(state, output);
 
-        stop = clock(); //Check the current clock tick count. This divided by CLOCKS_PER_SEC is the amount of clock ticks elapsed in a second.
-
-        //33333 cycles per frame, and screen is updated twice per frame (interrupt 1 and 2), so after half a frame's worth of cycles (16667) have passed, trigger 1st interrupt.
-        while (state->cyclecount >= 16667 && state->int_enable && nextInterrupt == 1){
-            start = clock(); //Start tick counter. Wait until it's time for the first render (top half of screen).
-            //Once 16667 cycles have run, wait until 1/120 of a second has passed. Framerate is 60hz, and you run two interrupts per frame, so that makes 1/120.
-            if (((float) (start - stop) / CLOCKS_PER_SEC) > 1.0/120.0){ //Compare the current clock tick count (start) with the amount of ticks since the last refresh (which was at "stop", so start - stop). (start - stop) divided by CLOCKS_PER_SEC equals time elapsed since last refresh.
-                //If cyclecount is much higher, set it to 16667 to keep the timing (note: might not be necessary?).
-                state->cyclecount = 16667;
+            i++;
+        }
 
-                //Interrupt 1.
-                Interrupt(state, output, &i, 1);
+        //Handle the event. The machine raises the interrupt, the host side waits for the right moment and updates the screen.
+        event = HandleNextEvent(state);
+        switch (event){
+            //Mid-screen interrupt (RST 1). Wait until 1/120 of a second has passed since the previous interrupt. Framerate is 60hz, and you run two interrupts per frame, so that makes 1/120.
+            case EVENT_MIDSCREEN:
+            if (speedMode != SPEED_UNCAPPED){
+                late = WaitNext();
+            }
 
+            //The terminal is only redrawn once per frame, at VBlank. So is the screen when running ahead.
+            if (videoOption == VIDEO_SDL && runAheadOption == 0 && RenderDue() && FrameSkipDue(late) == 0){
                 Render(state, window, renderer, Game);
+            }
+            break;
+
+            //VBlank interrupt (RST 2).
+            case EVENT_VBLANK:
+            MovieFrame(state, &myio);
 
-                nextInterrupt = 2;
+            if (speedMode != SPEED_UNCAPPED){
+                late = WaitNext();
             }
-        }
-        //Trigger 2nd interrupt.
-        while (state->cyclecount >= 33333 && state->int_enable && nextInterrupt == 2){
-            start = clock(); //Restart tick counter.
-            if (((float) (start - stop) / CLOCKS_PER_SEC) > 1.0/120.0){
-                //Reset cycle count. Once 33333 cycles have run, it should reset in order to correctly count the cycles that occur before the next interrupt.
-                state->cyclecount = 0;
 
-                //Interrupt 2.
-                Interrupt(state, output, &i, 2);
+            if (videoOption != VIDEO_NONE && RenderDue() && FrameSkipDue(late) == 0){
+                if (runAheadOption > 0){
+                    RunAhead(state, window, renderer, Game);
+                }
+                else if (videoOption == VIDEO_TERMINAL){
+                    TerminalRender(state);
+                }
+                else{
+                    Render(state, window, renderer, Game);
+                }
+            }
 
-                Render(state, window, renderer, Game);
+            CheckHotkeys();
 
-                nextInterrupt = 1;
+            stats.frames++;
+            stats.overruns = myio.overruns;
+            stats.audioUnderruns = AudioUnderruns();
+            stats.audioOverruns = AudioOverruns();
+            stats.audioLatency = AudioLatency();
+            stats.audioTarget = 1000.0 * AudioTarget() / audioRate;
+            if (ReportStats()){
+                ShowSpeed(window);
             }
+            break;
         }
 
-        i++;
+        //Sound is mixed up to the current cycle once per interrupt, with each sound starting at the cycle the game started it.
+        //Window and keyboard events are handled as often, and keys go to the machine, which samples them at the next interrupt (or frame, in deterministic mode).
+        if (event != EVENT_NONE){
+            UpdateSound(sources, &state->cyclecount, 1, (uint64_t) CPU_CLOCK * myio.clockMultiplier);
+            if (PollEvents(&myio) == 0){
+                break;
+            }
+        }
+
+        //The movie being played back has run out.
+        if (playOption != NULL && movie.frame >= movie.header.frames){
+            break;
+        }
+
+        //Fixed length run, for benchmarks and regression checks. Runs that are deterministic and given the same input print the same hash.
+        if (framesOption > 0 && myio.frame >= framesOption){
+            printf("Frame %llu: machine hash %016llx\n", (unsigned long long) myio.frame, (unsigned long long) MachineHash(state));
+            break;
+        }
     }
-    Render(state, window, renderer, Game);
+    if (videoOption == VIDEO_SDL){
+        Render(state, window, renderer, Game);
+    }
+
+    //Finish the movie, and for playback check it ended up where the recording did.
+    i = FinishMovie(state);
 
     //Clear memory.
     free(state->memory);
@@ -133,82 +312,662 @@ int main(int argc, char *argv[]){
     SDL_DestroyWindow(window);
     SDL_DestroyTexture(Game);
     SDL_DestroyRenderer(renderer);
+    if (CloseSound() != 0){
+        i = 1;
+    }
+    CloseBundle();
+    StopControllers();
     SDL_Quit();
+    return i;
 }
 
-int LoadFile(uint8_t *memory){
-    FILE *invaders;
-    long int filesize;
-    unsigned char *buffer;
-    int filecount = 4;
-    uint16_t memOffset = 0;
+//Check that the movie to be played back was recorded on this ROM, from the same state, and set the machine up the way it was. Or start recording, with the machine as it is now as the start state. Returns 0 on success, including when there is no movie.
+int StartMovie(State8080 *state, InvadersIO *io){
+    MovieHeader header;
+    uint32_t romCrc = RomSetCrc(machine->roms, state->memory);
+
+    if (playOption != NULL){
+        if (StartPlayback(&movie, playOption) != 0){
+            return 1;
+        }
+        if (movie.header.romCrc != romCrc){
+            printf("Error: movie was recorded with a different ROM (CRC %08x, this one is %08x)!\n", (unsigned) movie.header.romCrc, (unsigned) romCrc);
+            return 1;
+        }
+        if (movie.header.clockMultiplier < 1 || movie.header.clockMultiplier > MAX_CLOCK_MULTIPLIER){
+            printf("Error: movie has an invalid clock multiplier!\n");
+            return 1;
+        }
+        SetClockMultiplier(io, movie.header.clockMultiplier);
+        if (movie.header.startHash != MachineHash(state)){
+            printf("Error: movie was recorded from a different start state!\n");
+            return 1;
+        }
+
+        //The movie replaces the keyboard.
+        io->inputEnabled = 0;
+        ReleaseInput(io);
+    }
+    else if (recordOption != NULL){
+        header.romCrc = romCrc;
+        header.clockMultiplier = io->clockMultiplier;
+        header.startHash = MachineHash(state);
+        return StartRecording(&movie, recordOption, &header);
+    }
+    return 0;
+}
+
+//Called at every VBlank, once the machine has latched the input for the frame that's starting. Playback overwrites it with the recorded input, recording saves it.
+void MovieFrame(State8080 *state, InvadersIO *io){
+    if (playOption != NULL){
+        PlayFrame(&movie, &io->inputPorts[1], &io->inputPorts[2]);
+    }
+    else if (recordOption != NULL){
+        RecordFrame(&movie, io->inputPorts[1], io->inputPorts[2]);
+        movieEndHash = MachineHash(state);
+    }
+}
+
+//Close the movie. A movie that was played to the end must have left the machine exactly as the recording did, otherwise emulation has changed since it was recorded. Returns 1 if it doesn't match, so scripts can use playback as a regression test.
+int FinishMovie(State8080 *state){
+    uint64_t hash = MachineHash(state);
+
+    if (playOption != NULL){
+        StopPlayback(&movie);
+        if (movie.frame < movie.header.frames){
+            printf("Movie stopped at frame %llu of %llu.\n", (unsigned long long) movie.frame, (unsigned long long) movie.header.frames);
+            return 0;
+        }
+        if (hash != movie.header.endHash){
+            printf("Movie ended at frame %llu: machine hash %016llx, but the recording had %016llx!\n", (unsigned long long) movie.frame, (unsigned long long) hash, (unsigned long long) movie.header.endHash);
+            return 1;
+        }
+        printf("Movie ended at frame %llu: machine hash %016llx, same as the recording.\n", (unsigned long long) movie.frame, (unsigned long long) hash);
+    }
+    else if (recordOption != NULL){
+        if (FinishRecording(&movie, movieEndHash) != 0){
+            return 1;
+        }
+        printf("Recorded %llu frames.\n", (unsigned long long) movie.frame);
+    }
+    return 0;
+}
+
+//Reset the CPU, board hardware and sound, and allocate zeroed memory.
+void InitMachine(State8080 *state, InvadersIO *io, SoundSource *sound){
+    state->pc = 0;
+    if (cpmflag == 1) state->pc = 0x100; //For CP/M cpu diagnostics.
 
-    while (filecount > 0){
-        //Processor diagnostics.
-        if (cpmflag == 1){
+    //Set all registers and condition codes to 0.
+    state->cc.z = state->cc.s = state->cc.p = state->cc.cy = state->cc.ac = state->a = state->b = state->c = state->d = state->e = state->h = state->l = state->sp = state->int_enable = state->ei_cycle = state->cyclecount = 0;
+
+    //Allocate 64K. On Space Invaders 8K is used for the ROM, 8K for the RAM (of which 7K is VRAM). Processor has an address width of 16 bits however, so 2^16 = 65536 possible addresses. Plus the page that writes to ROM go to.
+    state->memory = calloc(MEMORY_SIZE, sizeof(uint8_t));
+    if (state->memory == NULL){
+        printf("Error: could not allocate memory for the machine!\n");
+        exit(1);
+    }
+
+    if (cpmflag) state->memory[0x05] = 0xD3; state->memory[0x06] = 0x01; state->memory[0x07] = 0xC9; //Set OUT 1. Return after OS call (CP/M diagnostics only).
+
+    InitIO(io);
+    SetClockMultiplier(io, clockOption);
+    io->latchInput = deterministicOption;
+    InitSoundSource(sound);
+    io->sound = sound;
+    state->io = io;
+}
 
-            //cpudiag //Cleared
-            //invaders = fopen("Processor diagnostics\\cpudiag\\cpudiag.bin", "rb"); memory += 0x100; //Offset memory by 0x100, since that's where cpudiag starts. Instructions begin there, and the pc should also start there.
+//Run several machines side by side, shown as a grid of thumbnails in one window. The first machine has already been set up and has the ROM loaded, the rest copy it.
+int RunMosaic(State8080 *first){
+    State8080 **machines;
+    State8080 *states;
+    InvadersIO *ios;
+    SoundSource *sounds;
+    SoundSource **sources;
+    uint64_t *cycles;
+    Mosaic mosaic;
+    double refreshInterval;
+    Uint64 lastRefresh;
+    int i;
+    uint8_t prevFocusKey = 0;
+    uint8_t prevPageUpKey = 0;
+    uint8_t prevPageDownKey = 0;
+
+    if (CreateMosaic(&mosaic, mosaicOption, mosaicColumnsOption, thumbScaleOption, 1024) != 0){
+        return 1;
+    }
 
-            //8080EXER
-            //invaders = fopen("Processor diagnostics\\8080EXER\\8080EXER.bin", "rb"); memory += 0x100;
+    machines = malloc(sizeof(State8080 *) * mosaicOption);
+    states = malloc(sizeof(State8080) * mosaicOption);
+    ios = malloc(sizeof(InvadersIO) * mosaicOption);
+    sounds = malloc(sizeof(SoundSource) * mosaicOption);
+    sources = malloc(sizeof(SoundSource *) * mosaicOption);
+    cycles = malloc(sizeof(uint64_t) * mosaicOption);
+    if (machines == NULL || states == NULL || ios == NULL || sounds == NULL || sources == NULL || cycles == NULL){
+        printf("Error: could not allocate memory for the machines!\n");
+        return 1;
+    }
 
-            //8080EXM //Cleared
-            //invaders = fopen("Processor diagnostics\\8080EXM\\8080EXM.bin", "rb"); memory += 0x100;
+    machines[0] = first;
+    i = 1;
+    while (i < mosaicOption){
+        InitMachine(&states[i], &ios[i], &sounds[i]);
+        memcpy(states[i].memory, first->memory, 0x10000); //Nothing has run yet, so this is just the ROMs.
+        machines[i] = &states[i];
+        i++;
+    }
+
+    //Only the machine with focus takes keyboard input. It's the only one heard too, unless they all are, each turned down so that together they're about as loud as one.
+    i = 0;
+    while (i < mosaicOption){
+        InvadersIO *io = machines[i]->io;
+        io->inputEnabled = (i == mosaic.focus);
+        io->soundEnabled = (i == mosaic.focus || mosaicSoundOption == MOSAIC_SOUND_ALL);
+        io->sound->gain = mosaicSoundOption == MOSAIC_SOUND_ALL ? 1.0f / sqrtf((float) mosaicOption) : 1.0f;
+        sources[i] = io->sound;
+        i++;
+    }
 
-            //8080PRE //Cleared
-            //invaders = fopen("Processor diagnostics\\8080PRE\\8080PRE.bin", "rb"); memory += 0x100;
+    //No vsync, since the loop below does its own pacing and presents less often than the display refreshes.
+    char title[128];
+    snprintf(title, sizeof(title), "%s mosaic", machine->title);
+    SDL_Window *window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, mosaic.columns * mosaic.thumbWidth, mosaic.visibleRows * mosaic.thumbHeight, SDL_WINDOW_SHOWN);
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if (CreateMosaicTexture(&mosaic, renderer) != 0){
+        return 1;
+    }
 
-            //CPUTEST //Cleared
-            //invaders = fopen("Processor diagnostics\\CPUTEST\\CPUTEST.bin", "rb"); memory += 0x100;
+    //Thumbnails are refreshed by the wall clock, like the main view in turbo and uncapped mode, so -thumbrate means the same whatever the speed. 0 refreshes every frame.
+    refreshInterval = thumbRateOption > 0 ? 1.0 / thumbRateOption : 0.0;
+    lastRefresh = TimerNow();
 
-            //TST8080 //Cleared
-            //invaders = fopen("Processor diagnostics\\TST8080\\TST8080.bin", "rb"); memory += 0x100;
+    pacerRate = 60.0;
+    InitPacer(&pacer, pacerRate);
+    SetSpeedMode(speedOption);
+    while (1){
+        //Every machine runs one frame, then the group waits until 1/60 of a second has passed since the previous frame.
+        i = 0;
+        while (i < mosaicOption){
+            EmulateFrame(machines[i]);
+            i++;
+        }
 
-            filecount = 1;
+        if (mosaicSoundOption == MOSAIC_SOUND_ALL){
+            i = 0;
+            while (i < mosaicOption){
+                cycles[i] = machines[i]->cyclecount;
+                i++;
+            }
+            UpdateSound(sources, cycles, mosaicOption, (uint64_t) CPU_CLOCK * ((InvadersIO *) machines[0]->io)->clockMultiplier);
         }
-        //Space invaders.
         else{
-            switch (filecount){
-                case 4:
-                //Open file in read binary mode. "r" by itself would be read text, which stops 0x1B from being read (it gets read as an EOF if the file is opened in text mode).
-                invaders = fopen("Place Game ROMs Here\\Invaders.h", "rb");
-                if (invaders == NULL){ printf("Error: Invaders.h file not found!\n");}
-                break;
-                case 3:
-                invaders = fopen("Place Game ROMs Here\\Invaders.g", "rb");
-                if (invaders == NULL){ printf("Error: Invaders.g file not found!\n");}
-                break;
-                case 2:
-                invaders = fopen("Place Game ROMs Here\\Invaders.f", "rb");
-                if (invaders == NULL){ printf("Error: Invaders.f file not found!\n");}
-                break;
-                case 1:
-                invaders = fopen("Place Game ROMs Here\\Invaders.e", "rb");
-                if (invaders == NULL){ printf("Error: Invaders.e file not found!\n");}
-                break;
+            UpdateSound(&sources[mosaic.focus], &machines[mosaic.focus]->cyclecount, 1, (uint64_t) CPU_CLOCK * ((InvadersIO *) machines[mosaic.focus]->io)->clockMultiplier);
+        }
+
+        stats.frames++;
+        stats.audioUnderruns = AudioUnderruns();
+        stats.audioOverruns = AudioOverruns();
+        stats.audioLatency = AudioLatency();
+        stats.audioTarget = 1000.0 * AudioTarget() / audioRate;
+        if (ReportStats()){
+            ShowSpeed(window);
+        }
+        if (TimerSeconds(TimerNow() - lastRefresh) >= refreshInterval){
+            lastRefresh = TimerNow();
+            RenderMosaic(&mosaic, machines, renderer);
+        }
+
+        //Tab moves the focus to the next machine, and the page follows it.
+        if (KeyPressed(SDL_SCANCODE_TAB, &prevFocusKey)){
+            InvadersIO *io = machines[mosaic.focus]->io;
+            io->inputEnabled = 0;
+            ReleaseInput(io);
+            if (mosaicSoundOption == MOSAIC_SOUND_FOCUS){
+                io->soundEnabled = 0;
+                StopAllSounds(io->sound);
+            }
+
+            mosaic.focus = (mosaic.focus + 1) % mosaicOption;
+            io = machines[mosaic.focus]->io;
+            io->inputEnabled = io->soundEnabled = 1;
+
+            while (mosaic.focus / mosaic.columns >= mosaic.firstRow + mosaic.visibleRows){
+                ScrollMosaic(&mosaic, 1);
+            }
+            while (mosaic.focus / mosaic.columns < mosaic.firstRow){
+                ScrollMosaic(&mosaic, -1);
+            }
+        }
+        if (KeyPressed(SDL_SCANCODE_PAGEUP, &prevPageUpKey)){
+            ScrollMosaic(&mosaic, -1);
+        }
+        if (KeyPressed(SDL_SCANCODE_PAGEDOWN, &prevPageDownKey)){
+            ScrollMosaic(&mosaic, 1);
+        }
+        if (PollEvents(machines[mosaic.focus]->io) == 0){
+            break;
+        }
+        CheckHotkeys();
+
+        if (speedMode != SPEED_UNCAPPED){
+            WaitPacer(&pacer);
+        }
+    }
+
+    DestroyMosaic(&mosaic);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    i = 1;
+    while (i < mosaicOption){
+        free(states[i].memory);
+        i++;
+    }
+    free(machines);
+    free(states);
+    free(ios);
+    free(sounds);
+    free(sources);
+    free(cycles);
+    return 0;
+}
+
+int ParseArguments(int argc, char *argv[]){
+    int i = 1;
+
+    while (i < argc){
+        //Colour overlay: taito, midway or mono.
+        if (strcmp(argv[i], "-overlay") == 0 && i + 1 < argc){
+            i++;
+            overlayOption = FindOverlay(argv[i]);
+            if (overlayOption == -1){
+                printf("Error: unknown overlay %s!\n", argv[i]);
+                return 1;
+            }
+        }
+        //Speed: -turbo n starts at n times real time, -uncapped as fast as possible, drawing the screen -previewrate times a second.
+        else if (strcmp(argv[i], "-turbo") == 0 && i + 1 < argc){
+            turboOption = atoi(argv[++i]);
+            if (turboOption < 1){
+                printf("Error: turbo speed must be at least 1!\n");
+                return 1;
+            }
+            speedOption = SPEED_TURBO;
+        }
+        else if (strcmp(argv[i], "-uncapped") == 0){
+            speedOption = SPEED_UNCAPPED;
+        }
+        else if (strcmp(argv[i], "-previewrate") == 0 && i + 1 < argc){
+            previewRateOption = atoi(argv[++i]);
+            if (previewRateOption < 1){
+                printf("Error: preview rate must be at least 1!\n");
+                return 1;
+            }
+        }
+        //Deterministic mode: interrupts are always timed by the cycle count, this also samples input only at the start of each frame. -frames n stops after n frames.
+        else if (strcmp(argv[i], "-deterministic") == 0){
+            deterministicOption = 1;
+        }
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc){
+            framesOption = strtoull(argv[++i], NULL, 10);
+        }
+        //Record input to a movie file, or play one back. Both need input sampled once per frame.
+        else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc){
+            recordOption = argv[++i];
+            deterministicOption = 1;
+        }
+        else if (strcmp(argv[i], "-play") == 0 && i + 1 < argc){
+            playOption = argv[++i];
+            deterministicOption = 1;
+        }
+        //Overclock the CPU to n times its real clock.
+        else if (strcmp(argv[i], "-overclock") == 0 && i + 1 < argc){
+            clockOption = atoi(argv[++i]);
+            if (clockOption < 1 || clockOption > MAX_CLOCK_MULTIPLIER){
+                printf("Error: overclock must be between 1 and %d!\n", MAX_CLOCK_MULTIPLIER);
+                return 1;
+            }
+        }
+        //Run-ahead: show the screen this many frames into the future to hide input lag.
+        else if (strcmp(argv[i], "-runahead") == 0 && i + 1 < argc){
+            runAheadOption = atoi(argv[++i]);
+        }
+        //Most screen updates that may be skipped in a row when the host can't keep up.
+        else if (strcmp(argv[i], "-frameskip") == 0 && i + 1 < argc){
+            frameSkipOption = atoi(argv[++i]);
+        }
+        //Print frame counters once per second.
+        else if (strcmp(argv[i], "-stats") == 0){
+            statsEnabled = 1;
+        }
+        //Video output: sdl (window), terminal (braille characters, for use over SSH) or none (headless, for benchmarks and movie playback).
+        else if (strcmp(argv[i], "-video") == 0 && i + 1 < argc){
+            i++;
+            if (strcmp(argv[i], "sdl") == 0){
+                videoOption = VIDEO_SDL;
+            }
+            else if (strcmp(argv[i], "terminal") == 0){
+                videoOption = VIDEO_TERMINAL;
+            }
+            else if (strcmp(argv[i], "none") == 0){
+                videoOption = VIDEO_NONE;
+            }
+            else{
+                printf("Error: unknown video output %s!\n", argv[i]);
+                return 1;
+            }
+        }
+        //Sound: synth (built in synthesizer), samples (WAV files in Sounds/) or off.
+        //Volume of everything, and of one sound (numbered as in Sounds/Readme.txt), in percent.
+        else if (strcmp(argv[i], "-volume") == 0 && i + 1 < argc){
+            SetMasterVolume(atoi(argv[++i]) / 100.0f);
+        }
+        else if (strcmp(argv[i], "-soundvolume") == 0 && i + 2 < argc){
+            int sound = atoi(argv[++i]);
+            if (sound < 0 || sound >= SOUND_COUNT){
+                printf("Error: sounds are numbered 0 to %d!\n", SOUND_COUNT - 1);
+                return 1;
+            }
+            SetSoundGain(sound, atoi(argv[++i]) / 100.0f);
+        }
+        else if (strcmp(argv[i], "-audiosync") == 0){
+            audioSyncOption = 1;
+        }
+        //Which game to run: invaders (default), invadpt2 or lrescue.
+        else if (strcmp(argv[i], "-game") == 0 && i + 1 < argc){
+            gameOption = FindMachine(argv[++i]);
+            if (gameOption == NULL){
+                printf("Error: unknown game %s!\n", argv[i]);
+                PrintMachines();
+                return 1;
+            }
+        }
+        //Where the ROM files are, and whether to load them even if they aren't known good dumps (hacks, bootlegs, homebrew).
+        else if (strcmp(argv[i], "-romdir") == 0 && i + 1 < argc){
+            romDirOption = argv[++i];
+        }
+        else if (strcmp(argv[i], "-nocheck") == 0){
+            romCheckOption = 0;
+        }
+        //Asset bundle made by the bundler, holding the ROMs and sounds in one file.
+        else if (strcmp(argv[i], "-bundle") == 0 && i + 1 < argc){
+            bundleOption = argv[++i];
+        }
+        //Write the sound to a WAV file. Driven by emulated time only, so it works headless and at any speed.
+        else if (strcmp(argv[i], "-wav") == 0 && i + 1 < argc){
+            wavOption = argv[++i];
+        }
+        //Audio latency bounds in milliseconds. Within them, it adapts to how steadily the host delivers audio.
+        else if (strcmp(argv[i], "-audiolatency") == 0 && i + 2 < argc){
+            minLatencyOption = atoi(argv[++i]);
+            maxLatencyOption = atoi(argv[++i]);
+            if (minLatencyOption < 0 || maxLatencyOption < minLatencyOption){
+                printf("Error: audio latency bounds must be 0 or more, minimum first!\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-sound") == 0 && i + 1 < argc){
+            i++;
+            if (strcmp(argv[i], "synth") == 0){
+                soundOption = SOUND_SYNTH;
+            }
+            else if (strcmp(argv[i], "samples") == 0){
+                soundOption = SOUND_SAMPLES;
+            }
+            else if (strcmp(argv[i], "off") == 0){
+                soundOption = SOUND_OFF;
+            }
+            else{
+                printf("Error: unknown sound source %s!\n", argv[i]);
+                return 1;
+            }
+        }
+        //Mosaic viewer: number of machines, grid columns, thumbnail downsampling (1, 2, 4 or 8) and thumbnail refreshes per second.
+        else if (strcmp(argv[i], "-mosaic") == 0 && i + 1 < argc){
+            mosaicOption = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-columns") == 0 && i + 1 < argc){
+            mosaicColumnsOption = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-thumbscale") == 0 && i + 1 < argc){
+            thumbScaleOption = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-thumbrate") == 0 && i + 1 < argc){
+            thumbRateOption = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-mosaicsound") == 0 && i + 1 < argc){
+            i++;
+            if (strcmp(argv[i], "focus") == 0){
+                mosaicSoundOption = MOSAIC_SOUND_FOCUS;
+            }
+            else if (strcmp(argv[i], "all") == 0){
+                mosaicSoundOption = MOSAIC_SOUND_ALL;
+            }
+            else{
+                printf("Error: unknown mosaic sound setting %s!\n", argv[i]);
+                return 1;
             }
         }
-        //Load the entire file into memory. Start by finding the end of the file.
-        if (fseek(invaders, 0L, SEEK_END) == 0){
-            //Get the current position (position at the end of the file). Remember it so that we know how much memory to allocate for storage.
-            filesize = ftell(invaders);
+        else{
+            printf("Error: unknown option %s!\n", argv[i]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (recordOption != NULL && playOption != NULL){
+        printf("Error: can't record and play back a movie at the same time!\n");
+        return 1;
+    }
+    if (wavOption != NULL && soundOption == SOUND_OFF){
+        printf("Error: -wav needs sound, it can't be used with -sound off!\n");
+        return 1;
+    }
+    if ((recordOption != NULL || playOption != NULL) && mosaicOption > 0){
+        printf("Error: movies can't be used in the mosaic viewer!\n");
+        return 1;
+    }
+    return 0;
+}
 
-            //Error checking.
-            if (filesize == -1){ printf("Error: could not create buffer size!\n"); }
+//Returns 1 if the key has gone down since the last check, so hotkeys act once per press rather than while the key is held. prevKey remembers the key's state between checks.
+int KeyPressed(SDL_Scancode key, uint8_t *prevKey){
+    uint8_t down = *(SDL_GetKeyboardState(NULL) + key);
+    int pressed = (down && *prevKey == 0);
+
+    *prevKey = down;
+    return pressed;
+}
 
-            //Go back to the start of the file.
-            if (fseek(invaders, 0L, SEEK_SET) != 0){ printf("Error: could not set the file pointer to the start of the file!\n"); }
+//Handle everything waiting in SDL's event queue, passing game keys on to the given machine, along with what the controllers have been up to. This is the only place events are read. Returns 0 if the window was closed.
+int PollEvents(InvadersIO *io){
+    SDL_Event event;
+    uint8_t held[3];
+    uint8_t pressed[3];
+    Uint64 delay;
+    int events;
+
+    delay = TakeControllerInput(held, pressed, &events);
+    InputController(io, held, pressed);
+    stats.inputEvents += events;
+    stats.inputDelayTicks += delay;
+
+    while (SDL_PollEvent(&event)){
+        switch (event.type){
+            case SDL_QUIT:
+            return 0;
+
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+            //Key repeat would count as extra presses.
+            if (event.key.repeat == 0){
+                InputKey(io, event.key.keysym.scancode, event.type == SDL_KEYDOWN);
+
+                //Event timestamps are in SDL_GetTicks milliseconds.
+                stats.inputEvents++;
+                stats.inputDelayTicks += TimerTicks((SDL_GetTicks() - event.key.timestamp) / 1000.0);
+            }
+            break;
+
+            //Rendering skips frames that haven't changed, so when the window has lost what it showed, the next frame has to be drawn anyway. Otherwise it stays blank until the game draws something.
+            case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_EXPOSED || event.window.event == SDL_WINDOWEVENT_SHOWN || event.window.event == SDL_WINDOWEVENT_RESTORED || event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED){
+                redrawScreen = 1;
+            }
+            break;
 
-            //Read the entire file into memory (into the buffer).
-            fread(memory + memOffset, sizeof(uint8_t), filesize, invaders);
-            memOffset += filesize;
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+            redrawScreen = 1;
+            break;
         }
-        filecount--;
     }
+    return 1;
+}
+
+//Check hotkeys once per frame.
+void CheckHotkeys(void){
+    static uint8_t prevOverlayKey = 0;
+    static uint8_t prevTurboKey = 0;
+    static uint8_t prevUncappedKey = 0;
+
+    //Cycle through the colour overlays.
+    if (KeyPressed(SDL_SCANCODE_O, &prevOverlayKey)){
+        SelectOverlay((currentOverlay + 1) % OVERLAY_COUNT);
+    }
+
+    //Toggle turbo and uncapped speed. Pressing the key for the current mode goes back to normal speed.
+    if (KeyPressed(SDL_SCANCODE_F, &prevTurboKey)){
+        SetSpeedMode(speedMode == SPEED_TURBO ? SPEED_NORMAL : SPEED_TURBO);
+    }
+    if (KeyPressed(SDL_SCANCODE_U, &prevUncappedKey)){
+        SetSpeedMode(speedMode == SPEED_UNCAPPED ? SPEED_NORMAL : SPEED_UNCAPPED);
+    }
+}
+
+void SetSpeedMode(int mode){
+    speedMode = mode;
+
+    //Turbo just runs the pacer faster. Uncapped doesn't use it at all.
+    SetPacerRate(&pacer, mode == SPEED_TURBO ? pacerRate * turboOption : pacerRate);
+
+    //Waiting for vsync on every present would hold emulation back to the display's refresh rate. That goes for pacing from the audio clock too, which the display's doesn't quite match.
+    if (vsyncRenderer != NULL){
+        SDL_RenderSetVSync(vsyncRenderer, mode == SPEED_NORMAL && audioSyncOption == 0);
+    }
+
+    //Sound only plays at normal speed. Faster, the machines are still mixed (so sounds are where they should be when it's back to normal) but nothing is queued.
+    SuspendAudio(mode != SPEED_NORMAL);
+}
+
+//Wait until the next interrupt is due, going by the wall clock or, with -audiosync at normal speed, by how much sound is still queued. Returns how far emulation has fallen behind, in ticks.
+Uint64 WaitNext(void){
+    if (audioSyncOption && speedMode == SPEED_NORMAL){
+        return WaitAudio();
+    }
+    return WaitPacer(&pacer);
+}
+
+//Whether to draw the screen this time round. At normal speed it's drawn at every interrupt. Faster than that, drawing every frame would only waste time on frames nobody can see, so the screen is drawn at most 60 times a second in turbo mode, and at the preview rate when uncapped.
+int RenderDue(void){
+    static Uint64 lastRender = 0;
+    Uint64 now;
+    double interval;
+
+    if (speedMode == SPEED_NORMAL){
+        return 1;
+    }
+
+    interval = (speedMode == SPEED_TURBO) ? 1.0 / 60.0 : 1.0 / previewRateOption;
+    now = TimerNow();
+    if (TimerSeconds(now - lastRender) < interval){
+        return 0;
+    }
+    lastRender = now;
+    return 1;
+}
+
+//Show the screen as it will be runAheadOption frames from now, then put the machine back. The frames in between are run with the input as it is now, so the player sees the result of pressing a key that many frames sooner than the game itself would show it.
+void RunAhead(State8080 *state, SDL_Window *window, SDL_Renderer *renderer, SDL_Texture *Game){
+    static MachineSnapshot snapshot;
+    int frame = 0;
+
+    SaveSnapshot(state, &snapshot);
+
+    //Sounds from frames that are going to be thrown away would play twice.
+    ((InvadersIO *) state->io)->soundEnabled = 0;
+    while (frame < runAheadOption){
+        EmulateFrame(state);
+        frame++;
+    }
+
+    if (videoOption == VIDEO_TERMINAL){
+        TerminalRender(state);
+    }
+    else{
+        Render(state, window, renderer, Game);
+    }
+
+    LoadSnapshot(state, &snapshot);
+}
+
+//Whether to skip drawing the screen because emulation has fallen behind the wall clock (late is how far behind, from WaitNext). Converting, uploading and presenting is the most expensive thing done outside the CPU, so skipping it lets a slow host catch up while the game itself keeps running at full speed. At most frameSkipOption updates are skipped in a row, so the picture never freezes completely.
+int FrameSkipDue(Uint64 late){
+    static int skipped = 0;
+
+    if (speedMode == SPEED_NORMAL && late > pacer.period && skipped < frameSkipOption){
+        skipped++;
+        stats.skippedRenders++;
+        return 1;
+    }
+    skipped = 0;
+    return 0;
+}
+
+//Show the measured speed in the window title, or under the picture in terminal mode. Called once a second.
+void ShowSpeed(SDL_Window *window){
+    static const char *modeNames[] = {"", "turbo", "uncapped"};
+    char title[128];
+
+    //Nothing to report at normal speed unless asked for with -stats, which prints it anyway.
+    if (speedMode == SPEED_NORMAL && window == NULL){
+        return;
+    }
+
+    snprintf(title, sizeof(title), "%s%s%s - %.2fx, %.0f fps", machine->title, speedMode == SPEED_NORMAL ? "" : " ", modeNames[speedMode], measuredSpeed, measuredFrameRate);
+    if (window != NULL){
+        SDL_SetWindowTitle(window, title);
+    }
+    else if (statsEnabled == 0){
+        TerminalStatus(title);
+    }
+}
 
-    fclose(invaders);
+//Load the ROMs into memory. Returns the address where the RAM starts (the end of the ROMs), or 0 if they couldn't be loaded.
+int LoadFile(uint8_t *memory){
+    //Processor diagnostics. These start at 0x100, since that's where CP/M programs are loaded, and the pc starts there too. Uncomment one.
+    if (cpmflag == 1){
+        //return LoadImage("Processor diagnostics/cpudiag/cpudiag.bin", memory + 0x100); //Cleared
+        //return LoadImage("Processor diagnostics/8080EXER/8080EXER.bin", memory + 0x100);
+        //return LoadImage("Processor diagnostics/8080EXM/8080EXM.bin", memory + 0x100); //Cleared
+        //return LoadImage("Processor diagnostics/8080PRE/8080PRE.bin", memory + 0x100); //Cleared
+        //return LoadImage("Processor diagnostics/CPUTEST/CPUTEST.bin", memory + 0x100); //Cleared
+        return LoadImage("Processor diagnostics/TST8080/TST8080.bin", memory + 0x100); //Cleared
+    }
 
-    //Address where the RAM starts.
-    return memOffset;
+    return LoadRomSet(machine->roms, romDirOption, memory, romCheckOption);
+}
+
+//Read a whole file into memory, unchecked. For the processor diagnostics, which aren't ROM sets. Returns the address just past it, or 0 on failure.
+int LoadImage(const char *path, uint8_t *memory){
+    FILE *file = fopen(path, "rb");
+    size_t size;
+
+    if (file == NULL){
+        printf("Error: %s not found!\n", path);
+        return 0;
+    }
+    size = fread(memory, 1, 0x10000 - 0x100, file);
+    fclose(file);
+    return 0x100 + (int) size;
 }